@@ -0,0 +1,16 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+namespace Imagine::Core {
+
+	/**
+	 * Write `path` through a temporary file renamed over it once complete,
+	 * a crash or a failed write never leaves a truncated file behind.
+	 * `writer` fills the binary stream. Returns false if the file can't be written, the previous one is kept.
+	 */
+	bool WriteFileAtomically(const std::filesystem::path& path, const std::function<void(std::ofstream&)>& writer);
+
+}
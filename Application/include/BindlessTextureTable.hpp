@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <ostream>
+
+namespace Imagine::Vulkan {
+
+	/**
+	 * A single descriptor set holding every texture of the application, the shaders index it with a texture ID.
+	 * Relies on descriptor indexing (Vulkan 1.2): the array is partially bound so only the registered slots need a valid image,
+	 * and update-after-bind so textures can be registered while the set is bound or used by the frames in flight.
+	 *
+	 * Binding 0 is the `texture2D` array, binding 1 the sampler shared by every texture (immutable).
+	 * Not thread safe.
+	 */
+	class BindlessTextureTable {
+	public:
+		static constexpr uint32_t c_DefaultCapacity = 4096;
+		static constexpr uint32_t c_TextureBinding = 0;
+		static constexpr uint32_t c_SamplerBinding = 1;
+
+	public:
+		BindlessTextureTable() = default;
+		~BindlessTextureTable();
+		BindlessTextureTable(const BindlessTextureTable&) = delete;
+		BindlessTextureTable& operator=(const BindlessTextureTable&) = delete;
+
+	public:
+		/**
+		 * @param sampler Baked in the layout, it must outlive the table.
+		 * @param capacity Clamped to the update-after-bind limits of the device.
+		 */
+		void Init(VkPhysicalDevice physicalDevice, VkDevice device, VkSampler sampler, uint32_t capacity = c_DefaultCapacity);
+		void Shutdown();
+
+		/**
+		 * Write the view in the next free slot.
+		 * The image must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL by the time it's sampled.
+		 * @return The texture ID to give the shaders.
+		 */
+		[[nodiscard]] uint32_t Register(VkImageView imageView);
+
+		[[nodiscard]] VkDescriptorSetLayout GetDescriptorSetLayout() const { return m_DescriptorSetLayout; }
+		[[nodiscard]] VkDescriptorSet GetDescriptorSet() const { return m_DescriptorSet; }
+		[[nodiscard]] uint32_t GetCount() const { return m_Count; }
+		[[nodiscard]] uint32_t GetCapacity() const { return m_Capacity; }
+
+		void LogStatistics(std::ostream& stream) const;
+
+	private:
+		VkDevice m_Device{VK_NULL_HANDLE};
+		VkSampler m_Sampler{VK_NULL_HANDLE};
+		VkDescriptorSetLayout m_DescriptorSetLayout{VK_NULL_HANDLE};
+		VkDescriptorPool m_DescriptorPool{VK_NULL_HANDLE};
+		VkDescriptorSet m_DescriptorSet{VK_NULL_HANDLE};
+		uint32_t m_Capacity{0};
+		uint32_t m_Count{0};
+	};
+
+} // namespace Imagine::Vulkan
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Imagine::Core {
+
+	/**
+	 * Stateless random numbers: each value is a hash of (seed, counter, stream).
+	 * Any thread can generate the value of any counter without generating the previous ones,
+	 * so splitting the work never changes the result.
+	 */
+	class CounterRandom {
+	public:
+		constexpr explicit CounterRandom(const uint64_t seed) : m_Seed(seed) {}
+
+	public:
+		// `stream` separates the independent values drawn for a same counter.
+		[[nodiscard]] constexpr uint64_t Next64(const uint64_t counter, const uint32_t stream = 0) const {
+			return Mix(m_Seed ^ Mix(counter * 0x9E3779B97F4A7C15ull + stream));
+		}
+
+		// Uniform in [0, 1).
+		[[nodiscard]] constexpr float NextFloat(const uint64_t counter, const uint32_t stream = 0) const {
+			// The 24 high bits fill the float mantissa exactly.
+			return static_cast<float>(Next64(counter, stream) >> 40) * (1.0f / 16777216.0f);
+		}
+
+	private:
+		// SplitMix64 finalizer.
+		[[nodiscard]] static constexpr uint64_t Mix(uint64_t value) {
+			value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+			value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+			return value ^ (value >> 31);
+		}
+
+	private:
+		uint64_t m_Seed;
+	};
+
+} // namespace Imagine::Core
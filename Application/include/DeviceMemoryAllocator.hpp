@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace Imagine::Vulkan {
+
+	/**
+	 * A piece of device memory handed out by the DeviceMemoryAllocator.
+	 * Resources must be bound at `memory` + `offset`, never at offset 0 of `memory`.
+	 */
+	struct MemoryAllocation {
+		static constexpr uint32_t c_DedicatedBlock = UINT32_MAX;
+
+		VkDeviceMemory memory{VK_NULL_HANDLE};
+		VkDeviceSize offset{0};
+		VkDeviceSize size{0};
+		// Persistently mapped pointer, already offset. nullptr if the memory isn't host visible.
+		void* mapped{nullptr};
+		uint32_t memoryTypeIndex{0};
+		uint32_t blockIndex{c_DedicatedBlock};
+
+		[[nodiscard]] bool IsValid() const { return memory != VK_NULL_HANDLE; }
+		[[nodiscard]] bool IsDedicated() const { return blockIndex == c_DedicatedBlock; }
+	};
+
+	enum class AllocationKind {
+		Buffer,
+		LinearImage,
+		// Images with VK_IMAGE_TILING_OPTIMAL must not share a `bufferImageGranularity` page with linear resources.
+		OptimalImage,
+	};
+
+	struct MemoryStatistics {
+		uint64_t blockCount{0};
+		uint64_t allocationCount{0};
+		uint64_t dedicatedAllocationCount{0};
+		// Size of all the blocks, whether used or not.
+		VkDeviceSize blockBytes{0};
+		// Bytes given to sub-allocations (alignment padding excluded).
+		VkDeviceSize usedBytes{0};
+		VkDeviceSize dedicatedBytes{0};
+		VkDeviceSize freeBytes{0};
+		VkDeviceSize largestFreeRange{0};
+
+		// 0 when all the free space is contiguous, close to 1 when it's scattered in tiny ranges.
+		[[nodiscard]] double GetFragmentation() const {
+			return freeBytes == 0 ? 0.0 : 1.0 - static_cast<double>(largestFreeRange) / static_cast<double>(freeBytes);
+		}
+
+		MemoryStatistics& operator+=(const MemoryStatistics& other);
+	};
+
+	/**
+	 * Block allocator for device memory.
+	 * Keeps a list of big VkDeviceMemory blocks per memory type and carves the resources in them,
+	 * only going through vkAllocateMemory when a block is full or when a resource is too big to share one.
+	 * Host visible blocks are mapped once for their whole lifetime.
+	 * Thread safe.
+	 */
+	class DeviceMemoryAllocator {
+	public:
+		static constexpr VkDeviceSize c_DefaultBlockSize = 64ull * 1024ull * 1024ull;
+
+	public:
+		DeviceMemoryAllocator() = default;
+		~DeviceMemoryAllocator();
+		DeviceMemoryAllocator(const DeviceMemoryAllocator&) = delete;
+		DeviceMemoryAllocator& operator=(const DeviceMemoryAllocator&) = delete;
+
+	public:
+		void Init(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize preferredBlockSize = c_DefaultBlockSize);
+		// Free every block. All the allocations must have been released beforehand.
+		void Shutdown();
+
+		[[nodiscard]] MemoryAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, AllocationKind kind);
+		void Free(MemoryAllocation& allocation);
+
+		// Allocate and bind the memory of the resource.
+		[[nodiscard]] MemoryAllocation AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+		[[nodiscard]] MemoryAllocation AllocateForImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties);
+
+		[[nodiscard]] uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+		[[nodiscard]] MemoryStatistics GetStatistics() const;
+		void LogStatistics(std::ostream& stream) const;
+
+	private:
+		struct MemoryBlock {
+			VkDeviceMemory memory{VK_NULL_HANDLE};
+			VkDeviceSize size{0};
+			void* mapped{nullptr};
+			// Offset -> Size. Adjacent ranges are always merged.
+			std::map<VkDeviceSize, VkDeviceSize> freeRanges{};
+			VkDeviceSize usedBytes{0};
+			uint64_t allocationCount{0};
+		};
+
+		struct MemoryTypePool {
+			// Released blocks leave a nullptr so that the block index of the allocations stays valid.
+			std::vector<std::unique_ptr<MemoryBlock>> blocks{};
+			uint64_t dedicatedAllocationCount{0};
+			VkDeviceSize dedicatedBytes{0};
+		};
+
+	private:
+		[[nodiscard]] VkDeviceMemory AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped);
+		[[nodiscard]] VkDeviceSize GetBlockSize(uint32_t memoryTypeIndex) const;
+		[[nodiscard]] static bool TryAllocateInBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+		static void ReleaseRange(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size);
+		[[nodiscard]] MemoryStatistics GetPoolStatistics(const MemoryTypePool& pool) const;
+
+	private:
+		VkPhysicalDevice m_PhysicalDevice{VK_NULL_HANDLE};
+		VkDevice m_Device{VK_NULL_HANDLE};
+		VkPhysicalDeviceMemoryProperties m_MemoryProperties{};
+		VkDeviceSize m_PreferredBlockSize{c_DefaultBlockSize};
+		VkDeviceSize m_BufferImageGranularity{1};
+		uint32_t m_MaxAllocationCount{0};
+		uint32_t m_DeviceAllocationCount{0};
+
+		std::array<MemoryTypePool, VK_MAX_MEMORY_TYPES> m_Pools{};
+		mutable std::mutex m_Mutex{};
+	};
+
+} // namespace Imagine::Vulkan
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#ifndef __linux__
+#include <unordered_map>
+#endif
+
+namespace Imagine::Core {
+
+	/**
+	 * Reports the files of a directory written since the last poll, to reload them while the application runs.
+	 * Uses inotify on Linux, elsewhere the modification times are compared at each poll.
+	 * Not recursive, not thread safe.
+	 */
+	class FileWatcher {
+	public:
+		FileWatcher() = default;
+		~FileWatcher();
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+	public:
+		// Returns false if the directory can't be watched.
+		bool Init(const std::filesystem::path& directory);
+		void Shutdown();
+
+		// Never blocks. The names of the files written since the last call, each reported once.
+		[[nodiscard]] std::vector<std::string> Poll();
+
+		[[nodiscard]] bool IsWatching() const;
+		[[nodiscard]] const std::filesystem::path& GetDirectory() const { return m_Directory; }
+
+	private:
+		std::filesystem::path m_Directory{};
+#ifdef __linux__
+		int m_Descriptor{-1};
+#else
+		void SnapshotWriteTimes(std::vector<std::string>* changedFiles);
+
+		std::unordered_map<std::string, std::filesystem::file_time_type> m_WriteTimes{};
+		bool m_Watching{false};
+#endif
+	};
+
+} // namespace Imagine::Core
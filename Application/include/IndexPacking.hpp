@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Imagine::Core {
+
+	/**
+	 * A run of triangles sharing one index size in a packed index buffer.
+	 * Indices are stored relative to `vertexOffset`, which goes to the vertexOffset of vkCmdDrawIndexed.
+	 */
+	struct IndexRange {
+		// Offset in bytes in the packed indices, aligned on 4.
+		uint64_t byteOffset{0};
+		uint32_t indexCount{0};
+		int32_t vertexOffset{0};
+		// 2 or 4 bytes.
+		uint32_t indexSize{4};
+
+		[[nodiscard]] uint64_t GetByteSize() const { return static_cast<uint64_t>(indexCount) * indexSize; }
+	};
+
+	/**
+	 * Convert 32 bits triangle lists to 16 bits indices wherever the vertices they reference fit in 65536 consecutive vertices.
+	 * Meshes referencing more vertices are split in several ranges, which works best once the vertices are in fetch order
+	 * (see MeshOptimizer::OptimizeVertexFetch) as consecutive triangles then reference close vertices.
+	 */
+	class IndexPacking {
+	public:
+		static constexpr uint32_t c_MaxIndex16 = UINT16_MAX;
+		// Shorter 16 bits ranges are merged in a 32 bits one, a draw call costs more than the bandwidth it saves.
+		static constexpr uint32_t c_MinSplitTriangleCount = 1024;
+
+	public:
+		// Split the triangles in ranges, `indices` being a triangle list.
+		[[nodiscard]] static std::vector<IndexRange> Split(const uint32_t* indices, size_t indexCount);
+		// Bytes needed by the ranges returned by Split.
+		[[nodiscard]] static uint64_t GetPackedSize(const std::vector<IndexRange>& ranges);
+		// Write the ranges in `destination`, which must hold GetPackedSize() bytes aligned on 4.
+		static void Pack(const uint32_t* indices, const std::vector<IndexRange>& ranges, void* destination);
+		/**
+		 * Write the indices [first, first + count) of a single range, to pack it piece by piece.
+		 * @param rangeIndices The source of the range, its first index.
+		 * @param destination Where the index `first` of the range goes. The padding ending a 16 bits range is written with its last index.
+		 */
+		static void PackRange(const uint32_t* rangeIndices, const IndexRange& range, uint32_t first, uint32_t count, void* destination);
+	};
+
+} // namespace Imagine::Core
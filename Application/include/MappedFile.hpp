@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace Imagine::Core {
+
+	/**
+	 * Read-only memory mapping of a whole file.
+	 * The pages are loaded by the OS on first access, opening a big file costs nothing until it's read.
+	 */
+	class MappedFile {
+	public:
+		MappedFile() = default;
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+	public:
+		// Returns false if the file can't be opened or is empty.
+		bool Open(const std::filesystem::path& path);
+		void Close();
+
+		[[nodiscard]] bool IsOpen() const { return m_Data != nullptr; }
+		[[nodiscard]] const std::byte* GetData() const { return m_Data; }
+		[[nodiscard]] uint64_t GetSize() const { return m_Size; }
+
+	private:
+		void Swap(MappedFile& other) noexcept;
+
+	private:
+		const std::byte* m_Data{nullptr};
+		uint64_t m_Size{0};
+#ifdef _WIN32
+		void* m_File{nullptr};
+		void* m_Mapping{nullptr};
+#endif
+	};
+
+} // namespace Imagine::Core
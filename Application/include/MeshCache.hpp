@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+#include "MappedFile.hpp"
+#include "Scene.hpp"
+
+namespace Imagine::Core {
+
+	/**
+	 * What a cache was built from. A cache whose key differs from the current one is stale.
+	 * The source is identified by its size and last write time rather than by hashing its content,
+	 * so that validating the cache never reads the source.
+	 */
+	struct MeshCacheKey {
+		uint64_t sourceSize{0};
+		int64_t sourceWriteTime{0};
+		// Import flags used to produce the mesh, e.g. aiPostProcessSteps.
+		uint32_t importFlags{0};
+		uint32_t vertexStride{0};
+		// Application defined processing applied after the import, e.g. optimization passes.
+		uint32_t processingFlags{0};
+
+		// Throws if the source doesn't exist.
+		[[nodiscard]] static MeshCacheKey FromSource(const std::filesystem::path& source, uint32_t importFlags, uint32_t vertexStride, uint32_t processingFlags = 0);
+
+		bool operator==(const MeshCacheKey& other) const = default;
+	};
+
+	// Everything stored in a cache, the arrays being owned by the caller.
+	struct MeshCacheData {
+		const void* vertices{nullptr};
+		uint64_t vertexCount{0};
+		const uint32_t* indices{nullptr};
+		uint64_t indexCount{0};
+		const SceneMesh* meshes{nullptr};
+		uint64_t meshCount{0};
+		const SceneInstance* instances{nullptr};
+		uint64_t instanceCount{0};
+	};
+
+	/**
+	 * Binary dump of an imported scene, stored next to its source: the vertices and 32 bits indices of every mesh,
+	 * the mesh table and the instance table.
+	 * The file is memory mapped, everything is read in place.
+	 * Vertices are stored as raw bytes in the native layout, the stride in the key guards against layout changes.
+	 */
+	class MeshCache {
+	public:
+		static constexpr uint32_t c_Magic = 0x48534D49; // "IMSH"
+		static constexpr uint32_t c_Version = 3;
+
+	public:
+		// "Assets/model.obj" -> "Assets/model.obj.meshcache"
+		[[nodiscard]] static std::filesystem::path GetCachePath(const std::filesystem::path& source);
+
+		// Returns false on failure, the previous cache is kept.
+		static bool Write(const std::filesystem::path& cachePath, const MeshCacheKey& key, const MeshCacheData& data);
+
+	public:
+		// Map the cache. Returns false if it's missing, stale or corrupted.
+		bool Open(const std::filesystem::path& cachePath, const MeshCacheKey& key);
+		void Close();
+
+		[[nodiscard]] bool IsOpen() const { return m_File.IsOpen(); }
+
+		[[nodiscard]] const void* GetVertexData() const { return m_Vertices; }
+		[[nodiscard]] uint64_t GetVertexCount() const { return m_VertexCount; }
+		[[nodiscard]] uint64_t GetVertexDataSize() const { return m_VertexCount * m_Key.vertexStride; }
+
+		[[nodiscard]] const uint32_t* GetIndices() const { return m_Indices; }
+		[[nodiscard]] uint64_t GetIndexCount() const { return m_IndexCount; }
+
+		[[nodiscard]] const SceneMesh* GetMeshes() const { return m_Meshes; }
+		[[nodiscard]] uint64_t GetMeshCount() const { return m_MeshCount; }
+
+		[[nodiscard]] const SceneInstance* GetInstances() const { return m_Instances; }
+		[[nodiscard]] uint64_t GetInstanceCount() const { return m_InstanceCount; }
+
+	private:
+		MappedFile m_File{};
+		MeshCacheKey m_Key{};
+		const void* m_Vertices{nullptr};
+		uint64_t m_VertexCount{0};
+		const uint32_t* m_Indices{nullptr};
+		uint64_t m_IndexCount{0};
+		const SceneMesh* m_Meshes{nullptr};
+		uint64_t m_MeshCount{0};
+		const SceneInstance* m_Instances{nullptr};
+		uint64_t m_InstanceCount{0};
+	};
+
+} // namespace Imagine::Core
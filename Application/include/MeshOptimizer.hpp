@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Imagine::Core {
+
+	struct VertexCacheStatistics {
+		// Vertex shader invocations, i.e. cache misses.
+		uint64_t transformedVertexCount{0};
+		uint64_t triangleCount{0};
+		// Vertices referenced by the indices.
+		uint64_t vertexCount{0};
+		// Average Cache Miss Ratio: transformed vertices per triangle, between 0.5 (ideal) and 3.
+		double acmr{0.0};
+		// Average Transformed to Vertex Ratio: transformed vertices per referenced vertex, 1 is ideal.
+		double atvr{0.0};
+
+		// Combine the statistics of several meshes, the ratios being recomputed from the sums.
+		VertexCacheStatistics& operator+=(const VertexCacheStatistics& other);
+	};
+
+	/**
+	 * Reordering passes for indexed triangle lists. Every pass keeps the same triangles, only their order (or the vertices order) changes.
+	 * Run them in order: vertex cache, then overdraw, then vertex fetch.
+	 */
+	class MeshOptimizer {
+	public:
+		// FIFO size used by the passes and the statistics. Small enough to be pessimistic on recent GPUs.
+		static constexpr uint32_t c_DefaultCacheSize = 16;
+		// How much the overdraw pass may degrade the ACMR of each cluster of triangles.
+		static constexpr double c_DefaultOverdrawThreshold = 1.05;
+
+	public:
+		// Simulate a FIFO post-transform cache of `cacheSize` entries.
+		[[nodiscard]] static VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = c_DefaultCacheSize);
+
+		// Reorder the triangles for the post-transform cache with Tipsify (Sander et al. 2007), linear in the number of triangles.
+		static void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = c_DefaultCacheSize);
+
+		/**
+		 * Reorder clusters of triangles so that the outward facing ones are drawn first, which lets the depth test reject more fragments.
+		 * Triangles keep their order inside a cluster, the clusters are cut where it costs at most `threshold` times their ACMR.
+		 * @param positions First float of the position of the first vertex, the position being 3 floats.
+		 * @param positionStride Bytes between two positions.
+		 */
+		static void OptimizeOverdraw(std::vector<uint32_t>& indices, const float* positions, size_t vertexCount, size_t positionStride, uint32_t cacheSize = c_DefaultCacheSize, double threshold = c_DefaultOverdrawThreshold);
+
+		/**
+		 * Reorder the vertices in the order the indices first use them and rewrite the indices accordingly.
+		 * Unreferenced vertices are dropped. Returns the new vertex count.
+		 */
+		static size_t OptimizeVertexFetch(std::vector<uint32_t>& indices, void* vertices, size_t vertexCount, size_t vertexStride);
+	};
+
+} // namespace Imagine::Core
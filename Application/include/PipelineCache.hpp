@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+
+namespace Imagine::Vulkan {
+
+	struct PipelineCacheStatistics {
+		uint32_t pipelineCount{0};
+		// Summed over the threads creating pipelines: CPU time rather than wall-clock time.
+		std::chrono::nanoseconds creationTime{0};
+		// creationTime when the startup pipelines were ready (see EndStartup), 0 until then.
+		// The one compared between runs, the pipelines built later (hot-reload, variants) don't count.
+		std::chrono::nanoseconds startupCreationTime{0};
+		// Size of the driver data loaded from the disk, 0 on a cold start.
+		uint64_t loadedBytes{0};
+		// Creation time of the last run that started without a cache, 0 if unknown.
+		std::chrono::nanoseconds coldCreationTime{0};
+	};
+
+	/**
+	 * A VkPipelineCache persisted on the disk between runs.
+	 * The driver data is only loaded when its header matches the current device (vendor, device ID and pipeline cache UUID),
+	 * a cache from another device or driver version is dropped and rebuilt.
+	 *
+	 * Pipelines are created through it so that their creation time is measured: the log of a warm start
+	 * compares it with the time of the last cold start, stored in the file.
+	 * The creation functions are thread safe, the rest must be called from a single thread without any creation running.
+	 */
+	class PipelineCache {
+	public:
+		static constexpr uint32_t c_Magic = 0x434C5049; // "IPLC"
+		static constexpr uint32_t c_Version = 1;
+
+	public:
+		PipelineCache() = default;
+		~PipelineCache();
+		PipelineCache(const PipelineCache&) = delete;
+		PipelineCache& operator=(const PipelineCache&) = delete;
+
+	public:
+		// Returns true when the cache was loaded from `path`, false when starting empty.
+		bool Init(VkPhysicalDevice physicalDevice, VkDevice device, const std::filesystem::path& path);
+		void Shutdown();
+
+		// Returns false on failure, the previous cache is kept.
+		bool Save() const;
+		// Record the creation time of every pipeline built so far as the startup one, saved as the reference of a cold start.
+		void EndStartup();
+
+		VkResult CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline& pipeline);
+		VkResult CreateComputePipeline(const VkComputePipelineCreateInfo& createInfo, VkPipeline& pipeline);
+
+		[[nodiscard]] VkPipelineCache GetHandle() const { return m_Cache; }
+		[[nodiscard]] bool IsWarm() const { return m_Statistics.loadedBytes > 0; }
+		[[nodiscard]] const PipelineCacheStatistics& GetStatistics() const { return m_Statistics; }
+		void LogStatistics(std::ostream& stream) const;
+
+	private:
+		[[nodiscard]] bool IsCompatible(const uint8_t* data, uint64_t size) const;
+
+	private:
+		VkDevice m_Device{VK_NULL_HANDLE};
+		VkPipelineCache m_Cache{VK_NULL_HANDLE};
+		VkPhysicalDeviceProperties m_Properties{};
+		std::filesystem::path m_Path{};
+		PipelineCacheStatistics m_Statistics{};
+		std::mutex m_StatisticsMutex{};
+		// Why the cache started empty, for the log.
+		const char* m_ColdReason{"not loaded"};
+	};
+
+} // namespace Imagine::Vulkan
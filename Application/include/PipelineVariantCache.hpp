@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace Imagine::Vulkan {
+
+	/**
+	 * Owns the pipelines of the application, each one being a variant of a pipeline ID
+	 * keyed on its specialization constants: the 32 bits value i is the constant_id i of the shaders.
+	 * A variant is built the first time it's requested, switching back to it later costs a lookup.
+	 *
+	 * Thread safe. The builder runs outside of the lock, two threads missing the same variant both build it and one is dropped.
+	 */
+	class PipelineVariantCache {
+	public:
+		// Must set the pSpecializationInfo of its stages, nullptr without constant.
+		using Builder = std::function<VkPipeline(const VkSpecializationInfo* specialization)>;
+
+	public:
+		PipelineVariantCache() = default;
+		~PipelineVariantCache();
+		PipelineVariantCache(const PipelineVariantCache&) = delete;
+		PipelineVariantCache& operator=(const PipelineVariantCache&) = delete;
+
+	public:
+		void Init(VkDevice device);
+		// Destroys every variant, none may be in use.
+		void Shutdown();
+
+		[[nodiscard]] VkPipeline Get(uint32_t pipeline, std::span<const uint32_t> constants, const Builder& builder);
+		// Build a variant without caching it, e.g. to replace the cached ones once the shader changed.
+		[[nodiscard]] static VkPipeline Build(std::span<const uint32_t> constants, const Builder& builder);
+		// Takes the ownership of `variant`, the variant with the same constants must have been evicted.
+		void Insert(uint32_t pipeline, std::span<const uint32_t> constants, VkPipeline variant);
+		// Gives back every variant of `pipeline`, to be destroyed by the caller once unused.
+		[[nodiscard]] std::vector<VkPipeline> Evict(uint32_t pipeline);
+
+		void LogStatistics(std::ostream& stream) const;
+
+	private:
+		using Key = std::pair<uint32_t, std::vector<uint32_t>>;
+
+	private:
+		VkDevice m_Device{VK_NULL_HANDLE};
+		std::map<Key, VkPipeline> m_Variants{};
+		uint64_t m_Hits{0};
+		uint64_t m_Misses{0};
+		mutable std::mutex m_Mutex{};
+	};
+
+} // namespace Imagine::Vulkan
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace Imagine::Core {
+
+	/**
+	 * A mesh stored once in the shared vertex and index buffers, in its own object space.
+	 * Its indices are relative to `firstVertex`.
+	 * Plain data, stored as is in the mesh cache.
+	 */
+	struct SceneMesh {
+		uint32_t firstVertex{0};
+		uint32_t vertexCount{0};
+		uint32_t firstIndex{0};
+		uint32_t indexCount{0};
+		// Object space axis aligned bounding box.
+		glm::vec3 boundsMin{0.0f};
+		uint32_t materialIndex{0};
+		glm::vec3 boundsMax{0.0f};
+		uint32_t padding{0};
+	};
+	static_assert(sizeof(SceneMesh) == 48, "SceneMesh is part of the mesh cache format.");
+
+	// A mesh placed in the scene. Several instances may reference the same mesh.
+	struct SceneInstance {
+		// Object to world, the node transforms of the hierarchy combined.
+		glm::mat4 transform{1.0f};
+		uint32_t meshIndex{0};
+		uint32_t padding[3]{};
+	};
+	static_assert(sizeof(SceneInstance) == 80, "SceneInstance is part of the mesh cache format.");
+
+} // namespace Imagine::Core
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * The SPIR-V of the shaders in `Shaders/`, compiled and optimized by the build (see add_spirv_shader in Application/CMakeLists.txt).
+ * Each `.spv.inc` is the comma separated list of words written by `glslc -mfmt=num`,
+ * a missing or invalid shader is a build error rather than an exception at startup.
+ */
+namespace Imagine::Vulkan::Shaders {
+
+	inline constexpr uint32_t c_ShaderVert[] = {
+#include "shader.vert.spv.inc"
+	};
+
+	inline constexpr uint32_t c_ShaderFrag[] = {
+#include "shader.frag.spv.inc"
+	};
+
+	inline constexpr uint32_t c_ShaderComp[] = {
+#include "shader.comp.spv.inc"
+	};
+
+	inline constexpr uint32_t c_ParticleVert[] = {
+#include "particle.vert.spv.inc"
+	};
+
+	inline constexpr uint32_t c_ParticleFrag[] = {
+#include "particle.frag.spv.inc"
+	};
+
+	inline constexpr uint32_t c_CullComp[] = {
+#include "cull.comp.spv.inc"
+	};
+
+	inline constexpr uint32_t c_DepthReduceComp[] = {
+#include "depth_reduce.comp.spv.inc"
+	};
+
+	// depth_reduce.comp with MULTISAMPLED defined.
+	inline constexpr uint32_t c_DepthReduceMultisampledComp[] = {
+#include "depth_reduce_ms.comp.spv.inc"
+	};
+
+} // namespace Imagine::Vulkan::Shaders
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Imagine::Core {
+
+	/**
+	 * Fixed set of worker threads consuming a FIFO of tasks, the ParallelFor helpers going ahead of the queue.
+	 * Tasks must not wait on other tasks of the same pool, it would deadlock once every worker waits.
+	 */
+	class ThreadPool {
+	public:
+		// 0 uses one thread per hardware thread.
+		explicit ThreadPool(uint32_t threadCount = 0);
+		~ThreadPool();
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+	public:
+		[[nodiscard]] uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Threads.size()); }
+
+		// Run `task` on a worker. Exceptions are forwarded to the future.
+		template<typename Task>
+		[[nodiscard]] std::future<std::invoke_result_t<Task>> Enqueue(Task&& task) {
+			using Result = std::invoke_result_t<Task>;
+			// std::function must be copyable, std::packaged_task isn't.
+			auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+			std::future<Result> future = packagedTask->get_future();
+			Push([packagedTask]() { (*packagedTask)(); });
+			return future;
+		}
+
+		/**
+		 * Split [0, count) in contiguous ranges of at least `grainSize` elements and call `function(begin, end)` on each.
+		 * The calling thread processes ranges until none is left, the workers helping as they become free:
+		 * with every worker busy on long tasks it doesn't wait behind them, it processes every range itself.
+		 * Blocks until every range is processed, then rethrows the first exception if any.
+		 */
+		void ParallelFor(uint64_t count, uint64_t grainSize, const std::function<void(uint64_t begin, uint64_t end)>& function);
+
+	private:
+		// `first` puts the task ahead of the queued ones.
+		void Push(std::function<void()> task, bool first = false);
+		void WorkerLoop();
+
+	private:
+		std::vector<std::thread> m_Threads{};
+		std::deque<std::function<void()>> m_Tasks{};
+		std::mutex m_Mutex{};
+		std::condition_variable m_Condition{};
+		bool m_Stopping{false};
+	};
+
+} // namespace Imagine::Core
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "DeviceMemoryAllocator.hpp"
+
+namespace Imagine::Vulkan {
+
+	/**
+	 * Identifies a submitted batch of uploads.
+	 * Tokens are ordered: once a token is complete, every token before it is too.
+	 */
+	struct UploadToken {
+		uint64_t value{0};
+
+		[[nodiscard]] bool IsValid() const { return value != 0; }
+	};
+
+	/**
+	 * Host visible memory reserved for the current batch.
+	 * Write through `mapped`, then record a copy from `buffer` at `offset`.
+	 */
+	struct StagingRegion {
+		VkBuffer buffer{VK_NULL_HANDLE};
+		VkDeviceSize offset{0};
+		VkDeviceSize size{0};
+		void* mapped{nullptr};
+	};
+
+	struct UploadQueue {
+		VkQueue queue{VK_NULL_HANDLE};
+		uint32_t familyIndex{0};
+	};
+
+	struct UploadStatistics {
+		uint64_t submittedBatchCount{0};
+		uint64_t copyCount{0};
+		uint64_t temporaryBufferCount{0};
+		uint64_t ownershipTransferCount{0};
+		VkDeviceSize stagedBytes{0};
+		// How many times Stage() had to wait on the GPU because the ring was full.
+		uint64_t ringStallCount{0};
+	};
+
+	/**
+	 * Batches uploads into a single command buffer per submission.
+	 * Data goes through a persistently mapped staging ring: the space used by a batch is given back once its fence signals,
+	 * so uploads never wait for the GPU unless the ring is full.
+	 *
+	 * Copies run on the transfer queue. When it belongs to another family than the owner queue (the graphics queue),
+	 * the resources are released by the transfer queue and acquired by the owner queue in a second command buffer,
+	 * which waits on the transfer through a semaphore. Commands that need the owner queue (e.g. blits) go in GetOwnerCommandBuffer().
+	 * With a single family both command buffers are the same.
+	 *
+	 * Not thread safe, use it from the thread owning the queues.
+	 */
+	class UploadBatcher {
+	public:
+		static constexpr VkDeviceSize c_DefaultRingSize = 32ull * 1024ull * 1024ull;
+		static constexpr uint32_t c_MaxBatchesInFlight = 4;
+
+	public:
+		UploadBatcher() = default;
+		~UploadBatcher();
+		UploadBatcher(const UploadBatcher&) = delete;
+		UploadBatcher& operator=(const UploadBatcher&) = delete;
+
+	public:
+		/**
+		 * @param transferQueue Queue executing the copies.
+		 * @param ownerQueue Queue using the uploaded resources, which receive their ownership.
+		 * @param copyAlignment Minimal alignment of every staging region,
+		 * usually VkPhysicalDeviceLimits::optimalBufferCopyOffsetAlignment.
+		 */
+		void Init(VkDevice device, DeviceMemoryAllocator& allocator, UploadQueue transferQueue, UploadQueue ownerQueue, VkDeviceSize ringSize = c_DefaultRingSize, VkDeviceSize copyAlignment = 16);
+		// Wait for every batch and release the ring.
+		void Shutdown();
+
+		/**
+		 * Reserve staging memory in the current batch.
+		 * Regions bigger than the ring get a temporary buffer, released with the batch.
+		 * Might submit the current batch to make room: always fetch the command buffer after staging.
+		 */
+		[[nodiscard]] StagingRegion Stage(VkDeviceSize size, VkDeviceSize alignment = 0);
+
+		// Transfer command buffer of the current batch, in the recording state.
+		[[nodiscard]] VkCommandBuffer GetCommandBuffer();
+		// Command buffer of the current batch executed on the owner queue, after every acquisition recorded so far.
+		[[nodiscard]] VkCommandBuffer GetOwnerCommandBuffer();
+
+		[[nodiscard]] bool HasDedicatedTransferQueue() const { return m_TransferQueue.familyIndex != m_OwnerQueue.familyIndex; }
+		// The regions up to this size are staged in the ring.
+		[[nodiscard]] VkDeviceSize GetRingSize() const { return m_RingSize; }
+
+		/**
+		 * Hand the buffer written by the transfer queue over to the owner queue.
+		 * @param dstAccess, dstStage How the owner queue is going to use the buffer.
+		 */
+		void TransferBufferOwnership(VkBuffer buffer, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+		// Same for an image, optionally changing its layout as part of the transfer.
+		void TransferImageOwnership(VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+
+		// Copy the data into `buffer`, going through the ring in chunks if needed.
+		void UploadBuffer(VkBuffer buffer, VkDeviceSize bufferOffset, const void* data, VkDeviceSize size);
+
+		// Copy tightly packed texels into the mip level 0 of `image`, that must be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
+		void UploadImage(VkImage image, VkExtent3D extent, VkImageAspectFlags aspect, const void* data, VkDeviceSize size);
+
+		// Submit what was recorded so far. Returns the token of the last submitted batch if nothing was recorded.
+		UploadToken Submit();
+
+		// Release the batches that completed without blocking.
+		void Poll();
+		[[nodiscard]] bool IsComplete(UploadToken token);
+		// Submit the batch of the token if it's still being recorded, then block until it completed.
+		void Wait(UploadToken token);
+		void WaitIdle();
+
+		[[nodiscard]] const UploadStatistics& GetStatistics() const { return m_Statistics; }
+		void LogStatistics(std::ostream& stream) const;
+
+	private:
+		enum class BatchState {
+			Idle,
+			Recording,
+			Pending,
+		};
+
+		struct Batch {
+			VkCommandBuffer commandBuffer{VK_NULL_HANDLE};
+			// Only when the transfer queue has its own family.
+			VkCommandBuffer ownerCommandBuffer{VK_NULL_HANDLE};
+			VkSemaphore transferSemaphore{VK_NULL_HANDLE};
+			bool usesOwnerQueue{false};
+			VkFence fence{VK_NULL_HANDLE};
+			BatchState state{BatchState::Idle};
+			uint64_t id{0};
+			// Bytes of the ring consumed by the batch, padding included.
+			VkDeviceSize ringBytes{0};
+			std::vector<std::pair<VkBuffer, MemoryAllocation>> temporaryBuffers{};
+		};
+
+	private:
+		Batch& BeginBatch();
+		void RetireBatch(Batch& batch);
+		void RetireOldest();
+		[[nodiscard]] bool TryAllocateInRing(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, VkDeviceSize& consumed);
+		[[nodiscard]] StagingRegion CreateTemporaryBuffer(Batch& batch, VkDeviceSize size);
+		void SubmitCommandBuffer(VkQueue queue, VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkSemaphore signalSemaphore, VkFence fence);
+
+	private:
+		VkDevice m_Device{VK_NULL_HANDLE};
+		DeviceMemoryAllocator* m_Allocator{nullptr};
+		UploadQueue m_TransferQueue{};
+		UploadQueue m_OwnerQueue{};
+		VkCommandPool m_CommandPool{VK_NULL_HANDLE};
+		VkCommandPool m_OwnerCommandPool{VK_NULL_HANDLE};
+
+		VkBuffer m_RingBuffer{VK_NULL_HANDLE};
+		MemoryAllocation m_RingMemory{};
+		VkDeviceSize m_RingSize{0};
+		VkDeviceSize m_CopyAlignment{16};
+		VkDeviceSize m_RingHead{0};
+		VkDeviceSize m_RingTail{0};
+		VkDeviceSize m_RingUsed{0};
+
+		std::array<Batch, c_MaxBatchesInFlight> m_Batches{};
+		// Indices in m_Batches, oldest submission first.
+		std::deque<uint32_t> m_PendingBatches{};
+		uint32_t m_CurrentBatch{0};
+		uint64_t m_NextBatchId{1};
+		uint64_t m_LastSubmittedId{0};
+		uint64_t m_LastCompletedId{0};
+
+		UploadStatistics m_Statistics{};
+	};
+
+} // namespace Imagine::Vulkan
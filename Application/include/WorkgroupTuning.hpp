@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <vector>
+
+namespace Imagine::Vulkan {
+
+	using DeviceUUID = std::array<uint8_t, VK_UUID_SIZE>;
+
+	struct WorkgroupTuningResult {
+		uint32_t particleCount{0};
+		uint32_t workgroupSize{0};
+		// GPU time of one dispatch with this workgroup size.
+		double dispatchMicroseconds{0.0};
+	};
+
+	/**
+	 * The best workgroup sizes measured on each device, stored between runs and keyed on the deviceUUID of VkPhysicalDeviceIDProperties.
+	 * The file is text, one result per line: "<device UUID> <particle count> <workgroup size> <dispatch microseconds>".
+	 */
+	class WorkgroupTuning {
+	public:
+		static constexpr uint32_t c_Version = 1;
+
+	public:
+		// Returns false when there is no file or it can't be read, nothing is tuned then.
+		bool Load(const std::filesystem::path& path);
+		// Returns false on failure, the previous file is kept.
+		bool Save(const std::filesystem::path& path) const;
+
+		// The size tuned for the particle count closest to `particleCount` on this device, 0 if the device was never tuned.
+		[[nodiscard]] uint32_t Find(const DeviceUUID& device, uint32_t particleCount) const;
+		// Replace every result of the device.
+		void Set(const DeviceUUID& device, std::vector<WorkgroupTuningResult> results);
+
+	private:
+		std::map<DeviceUUID, std::vector<WorkgroupTuningResult>> m_Devices{};
+	};
+
+} // namespace Imagine::Vulkan
@@ -0,0 +1,68 @@
+#include "AtomicFile.hpp"
+
+#include <system_error>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Imagine::Core {
+
+	namespace {
+		// Push the written data to the disk, the rename must not be durable before the content it exposes.
+		bool SyncFile(const std::filesystem::path& path) {
+#ifdef _WIN32
+			HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+			const bool synced = FlushFileBuffers(file) != 0;
+			CloseHandle(file);
+			return synced;
+#else
+			const int file = open(path.c_str(), O_WRONLY);
+			if (file < 0) {
+				return false;
+			}
+			const bool synced = fsync(file) == 0;
+			return close(file) == 0 && synced;
+#endif
+		}
+	}
+
+	bool WriteFileAtomically(const std::filesystem::path& path, const std::function<void(std::ofstream&)>& writer) {
+		std::filesystem::path temporaryPath = path;
+		temporaryPath += ".tmp";
+
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				return false;
+			}
+
+			writer(file);
+
+			// Closing flushes the buffered end of the data, which can still fail (a full disk).
+			file.close();
+			if (file.fail() || !SyncFile(temporaryPath)) {
+				std::error_code error;
+				std::filesystem::remove(temporaryPath, error);
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, path, error);
+		if (error) {
+			std::filesystem::remove(temporaryPath, error);
+			return false;
+		}
+		return true;
+	}
+
+}
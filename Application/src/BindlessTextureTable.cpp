@@ -0,0 +1,132 @@
+#include "BindlessTextureTable.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace Imagine::Vulkan {
+
+	BindlessTextureTable::~BindlessTextureTable() {
+		Shutdown();
+	}
+
+	void BindlessTextureTable::Init(const VkPhysicalDevice physicalDevice, const VkDevice device, const VkSampler sampler, const uint32_t capacity) {
+		m_Device = device;
+		m_Sampler = sampler;
+		m_Count = 0;
+
+		// The update-after-bind limits are separate from the regular ones, and usually much higher.
+		VkPhysicalDeviceVulkan12Properties properties12{};
+		properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &properties12;
+		vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+		m_Capacity = std::min({capacity, properties12.maxDescriptorSetUpdateAfterBindSampledImages, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages});
+		if (m_Capacity == 0) {
+			throw std::runtime_error("the device can't hold any update-after-bind sampled image!");
+		}
+
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		bindings[c_TextureBinding].binding = c_TextureBinding;
+		bindings[c_TextureBinding].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		bindings[c_TextureBinding].descriptorCount = m_Capacity;
+		bindings[c_TextureBinding].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		bindings[c_TextureBinding].pImmutableSamplers = nullptr;
+
+		bindings[c_SamplerBinding].binding = c_SamplerBinding;
+		bindings[c_SamplerBinding].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+		bindings[c_SamplerBinding].descriptorCount = 1;
+		bindings[c_SamplerBinding].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		bindings[c_SamplerBinding].pImmutableSamplers = &m_Sampler;
+
+		// The slots past the registered textures are never written, and the frames in flight never read the slots being registered.
+		std::array<VkDescriptorBindingFlags, 2> bindingFlags{};
+		bindingFlags[c_TextureBinding] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+		bindingFlags[c_SamplerBinding] = 0;
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+		if (vkCreateDescriptorSetLayout(m_Device, &layoutInfo, nullptr, &m_DescriptorSetLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create bindless texture descriptor set layout!");
+		}
+
+		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		poolSizes[0].descriptorCount = m_Capacity;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+		poolSizes[1].descriptorCount = 1;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		if (vkCreateDescriptorPool(m_Device, &poolInfo, nullptr, &m_DescriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create bindless texture descriptor pool!");
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = m_DescriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &m_DescriptorSetLayout;
+		if (vkAllocateDescriptorSets(m_Device, &allocInfo, &m_DescriptorSet) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate bindless texture descriptor set!");
+		}
+	}
+
+	void BindlessTextureTable::Shutdown() {
+		if (m_Device == VK_NULL_HANDLE) return;
+
+		// Frees the set with it.
+		vkDestroyDescriptorPool(m_Device, m_DescriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(m_Device, m_DescriptorSetLayout, nullptr);
+		m_DescriptorPool = VK_NULL_HANDLE;
+		m_DescriptorSetLayout = VK_NULL_HANDLE;
+		m_DescriptorSet = VK_NULL_HANDLE;
+		m_Sampler = VK_NULL_HANDLE;
+		m_Capacity = 0;
+		m_Count = 0;
+		m_Device = VK_NULL_HANDLE;
+	}
+
+	uint32_t BindlessTextureTable::Register(const VkImageView imageView) {
+		if (m_Count >= m_Capacity) {
+			throw std::runtime_error("the bindless texture table is full!");
+		}
+		const uint32_t textureIndex = m_Count++;
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.sampler = VK_NULL_HANDLE;
+		imageInfo.imageView = imageView;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = m_DescriptorSet;
+		descriptorWrite.dstBinding = c_TextureBinding;
+		descriptorWrite.dstArrayElement = textureIndex;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(m_Device, 1, &descriptorWrite, 0, nullptr);
+
+		return textureIndex;
+	}
+
+	void BindlessTextureTable::LogStatistics(std::ostream& stream) const {
+		stream << "[INFO] [TEXTURE] " << m_Count << "/" << m_Capacity << " bindless texture slots used." << std::endl;
+	}
+
+} // namespace Imagine::Vulkan
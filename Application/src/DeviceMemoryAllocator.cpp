@@ -0,0 +1,356 @@
+#include "DeviceMemoryAllocator.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace Imagine::Vulkan {
+
+	namespace {
+		VkDeviceSize AlignUp(const VkDeviceSize value, const VkDeviceSize alignment) {
+			return alignment <= 1 ? value : (value + alignment - 1) / alignment * alignment;
+		}
+
+		// Resources at least this big relative to a block get their own VkDeviceMemory.
+		// Mostly the big textures and render targets, sharing a block with them would waste most of it.
+		constexpr VkDeviceSize c_DedicatedSizeDivisor = 2;
+
+		// Don't let a single block eat a whole small heap (e.g. the 256MiB host visible device local heap).
+		constexpr VkDeviceSize c_MaxHeapFractionDivisor = 8;
+
+		double ToMiB(const VkDeviceSize bytes) {
+			return static_cast<double>(bytes) / (1024.0 * 1024.0);
+		}
+	}
+
+	MemoryStatistics& MemoryStatistics::operator+=(const MemoryStatistics& other) {
+		blockCount += other.blockCount;
+		allocationCount += other.allocationCount;
+		dedicatedAllocationCount += other.dedicatedAllocationCount;
+		blockBytes += other.blockBytes;
+		usedBytes += other.usedBytes;
+		dedicatedBytes += other.dedicatedBytes;
+		freeBytes += other.freeBytes;
+		largestFreeRange = std::max(largestFreeRange, other.largestFreeRange);
+		return *this;
+	}
+
+	DeviceMemoryAllocator::~DeviceMemoryAllocator() {
+		Shutdown();
+	}
+
+	void DeviceMemoryAllocator::Init(const VkPhysicalDevice physicalDevice, const VkDevice device, const VkDeviceSize preferredBlockSize) {
+		std::lock_guard lock(m_Mutex);
+		m_PhysicalDevice = physicalDevice;
+		m_Device = device;
+		m_PreferredBlockSize = preferredBlockSize;
+
+		vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &m_MemoryProperties);
+
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+		m_BufferImageGranularity = std::max<VkDeviceSize>(1, properties.limits.bufferImageGranularity);
+		m_MaxAllocationCount = properties.limits.maxMemoryAllocationCount;
+		m_DeviceAllocationCount = 0;
+	}
+
+	void DeviceMemoryAllocator::Shutdown() {
+		std::lock_guard lock(m_Mutex);
+		if (m_Device == VK_NULL_HANDLE) return;
+
+		for (MemoryTypePool& pool: m_Pools) {
+			for (std::unique_ptr<MemoryBlock>& block: pool.blocks) {
+				if (!block) continue;
+				// Freeing the memory implicitly unmaps it.
+				vkFreeMemory(m_Device, block->memory, nullptr);
+			}
+			pool = {};
+		}
+
+		m_DeviceAllocationCount = 0;
+		m_Device = VK_NULL_HANDLE;
+		m_PhysicalDevice = VK_NULL_HANDLE;
+	}
+
+	uint32_t DeviceMemoryAllocator::FindMemoryType(const uint32_t typeFilter, const VkMemoryPropertyFlags properties) const {
+		for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+
+		throw std::runtime_error("failed to find suitable memory type!");
+	}
+
+	VkDeviceSize DeviceMemoryAllocator::GetBlockSize(const uint32_t memoryTypeIndex) const {
+		const uint32_t heapIndex = m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+		const VkDeviceSize heapSize = m_MemoryProperties.memoryHeaps[heapIndex].size;
+		return std::max<VkDeviceSize>(1, std::min(m_PreferredBlockSize, heapSize / c_MaxHeapFractionDivisor));
+	}
+
+	VkDeviceMemory DeviceMemoryAllocator::AllocateDeviceMemory(const VkDeviceSize size, const uint32_t memoryTypeIndex, void** mapped) {
+		if (m_DeviceAllocationCount >= m_MaxAllocationCount) {
+			throw std::runtime_error("maxMemoryAllocationCount (" + std::to_string(m_MaxAllocationCount) + ") reached!");
+		}
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+		VkDeviceMemory memory{VK_NULL_HANDLE};
+		if (vkAllocateMemory(m_Device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate device memory!");
+		}
+		++m_DeviceAllocationCount;
+
+		*mapped = nullptr;
+		if (m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			// A VkDeviceMemory can only be mapped once, so we map it whole for its whole lifetime.
+			if (vkMapMemory(m_Device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+				vkFreeMemory(m_Device, memory, nullptr);
+				--m_DeviceAllocationCount;
+				throw std::runtime_error("failed to map device memory!");
+			}
+		}
+
+		return memory;
+	}
+
+	bool DeviceMemoryAllocator::TryAllocateInBlock(MemoryBlock& block, const VkDeviceSize size, const VkDeviceSize alignment, VkDeviceSize& offset) {
+		// Best fit: the smallest free range that can hold the aligned allocation.
+		auto best = block.freeRanges.end();
+		for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+			const VkDeviceSize alignedOffset = AlignUp(it->first, alignment);
+			if (alignedOffset + size > it->first + it->second) continue;
+			if (best == block.freeRanges.end() || it->second < best->second) {
+				best = it;
+			}
+		}
+
+		if (best == block.freeRanges.end()) {
+			return false;
+		}
+
+		const VkDeviceSize rangeOffset = best->first;
+		const VkDeviceSize rangeEnd = best->first + best->second;
+		offset = AlignUp(rangeOffset, alignment);
+		block.freeRanges.erase(best);
+
+		// Give back the alignment padding and the tail of the range.
+		if (offset > rangeOffset) {
+			block.freeRanges.emplace(rangeOffset, offset - rangeOffset);
+		}
+		if (offset + size < rangeEnd) {
+			block.freeRanges.emplace(offset + size, rangeEnd - (offset + size));
+		}
+
+		block.usedBytes += size;
+		++block.allocationCount;
+		return true;
+	}
+
+	void DeviceMemoryAllocator::ReleaseRange(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size) {
+		block.usedBytes -= size;
+		--block.allocationCount;
+
+		// Merge with the following free range.
+		auto next = block.freeRanges.lower_bound(offset);
+		if (next != block.freeRanges.end() && offset + size == next->first) {
+			size += next->second;
+			next = block.freeRanges.erase(next);
+		}
+
+		// Merge with the previous free range.
+		if (next != block.freeRanges.begin()) {
+			auto previous = std::prev(next);
+			if (previous->first + previous->second == offset) {
+				previous->second += size;
+				return;
+			}
+		}
+
+		block.freeRanges.emplace(offset, size);
+	}
+
+	MemoryAllocation DeviceMemoryAllocator::Allocate(const VkMemoryRequirements& requirements, const VkMemoryPropertyFlags properties, const AllocationKind kind) {
+		std::lock_guard lock(m_Mutex);
+
+		MemoryAllocation allocation{};
+		allocation.memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, properties);
+
+		VkDeviceSize size = requirements.size;
+		VkDeviceSize alignment = std::max<VkDeviceSize>(1, requirements.alignment);
+		if (kind == AllocationKind::OptimalImage) {
+			// Own whole granularity pages so that no linear resource can end up on the same page.
+			alignment = std::max(alignment, m_BufferImageGranularity);
+			size = AlignUp(size, m_BufferImageGranularity);
+		}
+
+		MemoryTypePool& pool = m_Pools[allocation.memoryTypeIndex];
+		const VkDeviceSize blockSize = GetBlockSize(allocation.memoryTypeIndex);
+
+		if (size >= blockSize / c_DedicatedSizeDivisor) {
+			allocation.memory = AllocateDeviceMemory(requirements.size, allocation.memoryTypeIndex, &allocation.mapped);
+			allocation.offset = 0;
+			allocation.size = requirements.size;
+			allocation.blockIndex = MemoryAllocation::c_DedicatedBlock;
+			++pool.dedicatedAllocationCount;
+			pool.dedicatedBytes += allocation.size;
+			return allocation;
+		}
+
+		auto fillFromBlock = [&](const uint32_t blockIndex, const VkDeviceSize offset) {
+			const MemoryBlock& block = *pool.blocks[blockIndex];
+			allocation.memory = block.memory;
+			allocation.offset = offset;
+			allocation.size = size;
+			allocation.mapped = block.mapped ? static_cast<uint8_t*>(block.mapped) + offset : nullptr;
+			allocation.blockIndex = blockIndex;
+		};
+
+		VkDeviceSize offset{0};
+		for (uint32_t i = 0; i < pool.blocks.size(); ++i) {
+			if (pool.blocks[i] && TryAllocateInBlock(*pool.blocks[i], size, alignment, offset)) {
+				fillFromBlock(i, offset);
+				return allocation;
+			}
+		}
+
+		// No room left, create a new block, reusing the slot of a released one if possible.
+		auto block = std::make_unique<MemoryBlock>();
+		block->size = blockSize;
+		block->memory = AllocateDeviceMemory(blockSize, allocation.memoryTypeIndex, &block->mapped);
+		block->freeRanges.emplace(0, blockSize);
+
+		auto slot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+		if (slot == pool.blocks.end()) {
+			slot = pool.blocks.insert(pool.blocks.end(), nullptr);
+		}
+		*slot = std::move(block);
+
+		const auto blockIndex = static_cast<uint32_t>(std::distance(pool.blocks.begin(), slot));
+		if (!TryAllocateInBlock(*pool.blocks[blockIndex], size, alignment, offset)) {
+			throw std::logic_error("fresh memory block too small for the allocation!");
+		}
+		fillFromBlock(blockIndex, offset);
+		return allocation;
+	}
+
+	void DeviceMemoryAllocator::Free(MemoryAllocation& allocation) {
+		if (!allocation.IsValid()) return;
+
+		std::lock_guard lock(m_Mutex);
+		MemoryTypePool& pool = m_Pools[allocation.memoryTypeIndex];
+
+		if (allocation.IsDedicated()) {
+			vkFreeMemory(m_Device, allocation.memory, nullptr);
+			--m_DeviceAllocationCount;
+			--pool.dedicatedAllocationCount;
+			pool.dedicatedBytes -= allocation.size;
+			allocation = {};
+			return;
+		}
+
+		MemoryBlock& block = *pool.blocks.at(allocation.blockIndex);
+		ReleaseRange(block, allocation.offset, allocation.size);
+
+		// Keep one empty block around to avoid thrashing vkAllocateMemory, release the others.
+		if (block.allocationCount == 0) {
+			const bool otherEmptyBlock = std::any_of(pool.blocks.begin(), pool.blocks.end(), [&block](const std::unique_ptr<MemoryBlock>& other) {
+				return other && other.get() != &block && other->allocationCount == 0;
+			});
+			if (otherEmptyBlock) {
+				vkFreeMemory(m_Device, block.memory, nullptr);
+				--m_DeviceAllocationCount;
+				pool.blocks[allocation.blockIndex].reset();
+			}
+		}
+
+		allocation = {};
+	}
+
+	MemoryAllocation DeviceMemoryAllocator::AllocateForBuffer(const VkBuffer buffer, const VkMemoryPropertyFlags properties) {
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(m_Device, buffer, &memRequirements);
+
+		MemoryAllocation allocation = Allocate(memRequirements, properties, AllocationKind::Buffer);
+		if (vkBindBufferMemory(m_Device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+			Free(allocation);
+			throw std::runtime_error("failed to bind buffer memory!");
+		}
+		return allocation;
+	}
+
+	MemoryAllocation DeviceMemoryAllocator::AllocateForImage(const VkImage image, const VkImageTiling tiling, const VkMemoryPropertyFlags properties) {
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(m_Device, image, &memRequirements);
+
+		const AllocationKind kind = tiling == VK_IMAGE_TILING_OPTIMAL ? AllocationKind::OptimalImage : AllocationKind::LinearImage;
+		MemoryAllocation allocation = Allocate(memRequirements, properties, kind);
+		if (vkBindImageMemory(m_Device, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+			Free(allocation);
+			throw std::runtime_error("failed to bind image memory!");
+		}
+		return allocation;
+	}
+
+	MemoryStatistics DeviceMemoryAllocator::GetPoolStatistics(const MemoryTypePool& pool) const {
+		MemoryStatistics statistics{};
+		statistics.dedicatedAllocationCount = pool.dedicatedAllocationCount;
+		statistics.dedicatedBytes = pool.dedicatedBytes;
+		statistics.allocationCount = pool.dedicatedAllocationCount;
+
+		for (const std::unique_ptr<MemoryBlock>& block: pool.blocks) {
+			if (!block) continue;
+			++statistics.blockCount;
+			statistics.allocationCount += block->allocationCount;
+			statistics.blockBytes += block->size;
+			statistics.usedBytes += block->usedBytes;
+			for (const auto& [offset, size]: block->freeRanges) {
+				statistics.freeBytes += size;
+				statistics.largestFreeRange = std::max(statistics.largestFreeRange, size);
+			}
+		}
+
+		return statistics;
+	}
+
+	MemoryStatistics DeviceMemoryAllocator::GetStatistics() const {
+		std::lock_guard lock(m_Mutex);
+		MemoryStatistics total{};
+		for (const MemoryTypePool& pool: m_Pools) {
+			total += GetPoolStatistics(pool);
+		}
+		return total;
+	}
+
+	void DeviceMemoryAllocator::LogStatistics(std::ostream& stream) const {
+		std::lock_guard lock(m_Mutex);
+		const auto flags = stream.flags();
+		stream << std::fixed << std::setprecision(2);
+
+		MemoryStatistics total{};
+		for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; ++i) {
+			const MemoryStatistics statistics = GetPoolStatistics(m_Pools[i]);
+			if (statistics.blockCount == 0 && statistics.dedicatedAllocationCount == 0) continue;
+
+			stream << "[INFO] [MEMORY] Type " << i
+				   << ": " << statistics.allocationCount << " allocations"
+				   << ", " << statistics.blockCount << " blocks (" << ToMiB(statistics.blockBytes) << " MiB, " << ToMiB(statistics.usedBytes) << " MiB used)"
+				   << ", " << statistics.dedicatedAllocationCount << " dedicated (" << ToMiB(statistics.dedicatedBytes) << " MiB)"
+				   << ", fragmentation " << statistics.GetFragmentation() * 100.0 << "%" << std::endl;
+			total += statistics;
+		}
+
+		stream << "[INFO] [MEMORY] Total: " << total.allocationCount << " allocations in " << m_DeviceAllocationCount << "/" << m_MaxAllocationCount << " device allocations"
+			   << ", " << ToMiB(total.usedBytes + total.dedicatedBytes) << " MiB used of " << ToMiB(total.blockBytes + total.dedicatedBytes) << " MiB"
+			   << ", largest free range " << ToMiB(total.largestFreeRange) << " MiB"
+			   << ", fragmentation " << total.GetFragmentation() * 100.0 << "%" << std::endl;
+
+		stream.flags(flags);
+	}
+
+} // namespace Imagine::Vulkan
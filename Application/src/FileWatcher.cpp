@@ -0,0 +1,126 @@
+#include "FileWatcher.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace Imagine::Core {
+
+	FileWatcher::~FileWatcher() {
+		Shutdown();
+	}
+
+#ifdef __linux__
+
+	bool FileWatcher::Init(const std::filesystem::path& directory) {
+		Shutdown();
+		m_Directory = directory;
+
+		m_Descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (m_Descriptor < 0) {
+			return false;
+		}
+		// Written in place, or written aside then renamed over the file like most editors do.
+		if (inotify_add_watch(m_Descriptor, m_Directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+			Shutdown();
+			return false;
+		}
+		return true;
+	}
+
+	void FileWatcher::Shutdown() {
+		if (m_Descriptor >= 0) {
+			close(m_Descriptor);
+			m_Descriptor = -1;
+		}
+	}
+
+	bool FileWatcher::IsWatching() const {
+		return m_Descriptor >= 0;
+	}
+
+	std::vector<std::string> FileWatcher::Poll() {
+		std::vector<std::string> changedFiles;
+		if (m_Descriptor < 0) {
+			return changedFiles;
+		}
+
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(m_Descriptor, buffer, sizeof(buffer))) > 0) {
+			for (ssize_t offset = 0; offset < length;) {
+				const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+				if (event->len > 0 && (event->mask & IN_ISDIR) == 0) {
+					changedFiles.emplace_back(event->name);
+				}
+				offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+			}
+		}
+
+		// A single save can be several events.
+		std::sort(changedFiles.begin(), changedFiles.end());
+		changedFiles.erase(std::unique(changedFiles.begin(), changedFiles.end()), changedFiles.end());
+		return changedFiles;
+	}
+
+#else
+
+	bool FileWatcher::Init(const std::filesystem::path& directory) {
+		Shutdown();
+		m_Directory = directory;
+
+		std::error_code error;
+		if (!std::filesystem::is_directory(m_Directory, error)) {
+			return false;
+		}
+		SnapshotWriteTimes(nullptr);
+		m_Watching = true;
+		return true;
+	}
+
+	void FileWatcher::Shutdown() {
+		m_WriteTimes.clear();
+		m_Watching = false;
+	}
+
+	bool FileWatcher::IsWatching() const {
+		return m_Watching;
+	}
+
+	std::vector<std::string> FileWatcher::Poll() {
+		std::vector<std::string> changedFiles;
+		if (m_Watching) {
+			SnapshotWriteTimes(&changedFiles);
+			std::sort(changedFiles.begin(), changedFiles.end());
+		}
+		return changedFiles;
+	}
+
+	void FileWatcher::SnapshotWriteTimes(std::vector<std::string>* changedFiles) {
+		std::error_code error;
+		for (const std::filesystem::directory_entry& entry: std::filesystem::directory_iterator(m_Directory, error)) {
+			if (!entry.is_regular_file(error)) {
+				continue;
+			}
+			const std::filesystem::file_time_type writeTime = entry.last_write_time(error);
+			if (error) {
+				continue;
+			}
+
+			const std::string name = entry.path().filename().string();
+			const auto it = m_WriteTimes.find(name);
+			if (it == m_WriteTimes.end() || it->second != writeTime) {
+				m_WriteTimes[name] = writeTime;
+				if (changedFiles) {
+					changedFiles->push_back(name);
+				}
+			}
+		}
+	}
+
+#endif
+
+} // namespace Imagine::Core
@@ -0,0 +1,109 @@
+#include "IndexPacking.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace Imagine::Core {
+
+	namespace {
+		uint64_t AlignUp(const uint64_t value, const uint64_t alignment) {
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	std::vector<IndexRange> IndexPacking::Split(const uint32_t* indices, const size_t indexCount) {
+		if (indexCount % 3 != 0) {
+			throw std::runtime_error("the index count isn't a multiple of 3!");
+		}
+
+		// Every range is described by its first index in `indices` until the byte offsets are computed.
+		std::vector<IndexRange> ranges{};
+		std::vector<size_t> firstIndices{};
+		const auto appendTriangles = [&ranges, &firstIndices](const size_t first, const size_t count, const uint32_t indexSize, const uint32_t vertexOffset) {
+			// Consecutive 32 bits ranges are merged, they don't need a common vertex offset.
+			if (indexSize == 4 && !ranges.empty() && ranges.back().indexSize == 4 && firstIndices.back() + ranges.back().indexCount == first) {
+				ranges.back().indexCount += static_cast<uint32_t>(count);
+				return;
+			}
+			IndexRange range{};
+			range.indexCount = static_cast<uint32_t>(count);
+			range.vertexOffset = static_cast<int32_t>(vertexOffset);
+			range.indexSize = indexSize;
+			ranges.push_back(range);
+			firstIndices.push_back(first);
+		};
+
+		size_t first = 0;
+		while (first < indexCount) {
+			// Grow the range as long as its vertices fit in 16 bits relative to its smallest vertex.
+			uint32_t minVertex = UINT32_MAX;
+			uint32_t maxVertex = 0;
+			size_t end = first;
+			while (end < indexCount) {
+				const uint32_t triangleMin = std::min({indices[end], indices[end + 1], indices[end + 2]});
+				const uint32_t triangleMax = std::max({indices[end], indices[end + 1], indices[end + 2]});
+				const uint32_t newMin = std::min(minVertex, triangleMin);
+				const uint32_t newMax = std::max(maxVertex, triangleMax);
+				if (newMax - newMin > c_MaxIndex16) break;
+				minVertex = newMin;
+				maxVertex = newMax;
+				end += 3;
+			}
+
+			const size_t triangleCount = (end - first) / 3;
+			const bool reachedEnd = end == indexCount;
+			// 32 bits ranges keep absolute indices, with a vertex offset of 0.
+			if (triangleCount == 0) {
+				// A single triangle spanning more than 65536 vertices.
+				appendTriangles(first, 3, 4, 0);
+				first += 3;
+			} else if (triangleCount < c_MinSplitTriangleCount && !(first == 0 && reachedEnd)) {
+				appendTriangles(first, end - first, 4, 0);
+				first = end;
+			} else {
+				appendTriangles(first, end - first, 2, minVertex);
+				first = end;
+			}
+		}
+
+		uint64_t byteOffset = 0;
+		for (IndexRange& range: ranges) {
+			byteOffset = AlignUp(byteOffset, 4);
+			range.byteOffset = byteOffset;
+			byteOffset += range.GetByteSize();
+		}
+
+		// The ranges are in order, Pack() finds the source of each one from the counts.
+		return ranges;
+	}
+
+	uint64_t IndexPacking::GetPackedSize(const std::vector<IndexRange>& ranges) {
+		return ranges.empty() ? 0 : AlignUp(ranges.back().byteOffset + ranges.back().GetByteSize(), 4);
+	}
+
+	void IndexPacking::Pack(const uint32_t* indices, const std::vector<IndexRange>& ranges, void* destination) {
+		auto* bytes = static_cast<std::byte*>(destination);
+		size_t source = 0;
+		for (const IndexRange& range: ranges) {
+			PackRange(indices + source, range, 0, range.indexCount, bytes + range.byteOffset);
+			source += range.indexCount;
+		}
+	}
+
+	void IndexPacking::PackRange(const uint32_t* rangeIndices, const IndexRange& range, const uint32_t first, const uint32_t count, void* destination) {
+		if (range.indexSize == 2) {
+			auto* indices16 = static_cast<uint16_t*>(destination);
+			for (uint32_t i = 0; i < count; ++i) {
+				indices16[i] = static_cast<uint16_t>(rangeIndices[first + i] - static_cast<uint32_t>(range.vertexOffset));
+			}
+			// Keep the padding up to the next range deterministic.
+			if (first + count == range.indexCount && range.indexCount % 2 != 0) {
+				indices16[count] = 0;
+			}
+		} else {
+			std::memcpy(destination, rangeIndices + first, static_cast<size_t>(count) * sizeof(uint32_t));
+		}
+	}
+
+} // namespace Imagine::Core
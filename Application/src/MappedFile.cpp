@@ -0,0 +1,131 @@
+#include "MappedFile.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Imagine::Core {
+
+	MappedFile::~MappedFile() {
+		Close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept {
+		Swap(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+		if (this != &other) {
+			Close();
+			Swap(other);
+		}
+		return *this;
+	}
+
+	void MappedFile::Swap(MappedFile& other) noexcept {
+		std::swap(m_Data, other.m_Data);
+		std::swap(m_Size, other.m_Size);
+#ifdef _WIN32
+		std::swap(m_File, other.m_File);
+		std::swap(m_Mapping, other.m_Mapping);
+#endif
+	}
+
+#ifdef _WIN32
+	bool MappedFile::Open(const std::filesystem::path& path) {
+		Close();
+
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			CloseHandle(file);
+			return false;
+		}
+
+		const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (data == nullptr) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		m_File = file;
+		m_Mapping = mapping;
+		m_Data = static_cast<const std::byte*>(data);
+		m_Size = static_cast<uint64_t>(size.QuadPart);
+		return true;
+	}
+
+	void MappedFile::Close() {
+		if (m_Data != nullptr) {
+			UnmapViewOfFile(m_Data);
+		}
+		if (m_Mapping != nullptr) {
+			CloseHandle(m_Mapping);
+		}
+		if (m_File != nullptr) {
+			CloseHandle(m_File);
+		}
+		m_Data = nullptr;
+		m_Size = 0;
+		m_Mapping = nullptr;
+		m_File = nullptr;
+	}
+#else
+	bool MappedFile::Open(const std::filesystem::path& path) {
+		Close();
+
+		const int file = open(path.c_str(), O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+
+		struct stat status{};
+		if (fstat(file, &status) != 0 || status.st_size <= 0) {
+			close(file);
+			return false;
+		}
+
+		void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		// The mapping keeps its own reference on the file.
+		close(file);
+		if (data == MAP_FAILED) {
+			return false;
+		}
+		// Files are mostly streamed front to back, let the kernel read ahead.
+		posix_madvise(data, static_cast<size_t>(status.st_size), POSIX_MADV_SEQUENTIAL);
+
+		m_Data = static_cast<const std::byte*>(data);
+		m_Size = static_cast<uint64_t>(status.st_size);
+		return true;
+	}
+
+	void MappedFile::Close() {
+		if (m_Data != nullptr) {
+			munmap(const_cast<std::byte*>(m_Data), static_cast<size_t>(m_Size));
+		}
+		m_Data = nullptr;
+		m_Size = 0;
+	}
+#endif
+
+} // namespace Imagine::Core
@@ -0,0 +1,152 @@
+#include "MeshCache.hpp"
+#include "AtomicFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Imagine::Core {
+
+	namespace {
+		// Sections start on 16 bytes, any vertex attribute can be read in place.
+		constexpr uint64_t c_SectionAlignment = 16;
+
+		struct MeshCacheSection {
+			uint64_t offset;
+			uint64_t count;
+		};
+
+		struct MeshCacheHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint64_t sourceSize;
+			int64_t sourceWriteTime;
+			uint32_t importFlags;
+			uint32_t vertexStride;
+			uint32_t processingFlags;
+			uint32_t reserved;
+			MeshCacheSection vertices;
+			MeshCacheSection indices;
+			MeshCacheSection meshes;
+			MeshCacheSection instances;
+		};
+		static_assert(sizeof(MeshCacheHeader) == 104, "The header layout is part of the file format.");
+
+		uint64_t AlignUp(const uint64_t value, const uint64_t alignment) {
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		// Never trust the offsets of a file that could have been truncated or tampered with.
+		bool IsSectionValid(const MeshCacheSection& section, const uint64_t elementSize, const uint64_t fileSize) {
+			return section.offset % c_SectionAlignment == 0 && section.offset <= fileSize && section.count <= (fileSize - section.offset) / std::max<uint64_t>(1, elementSize);
+		}
+	}
+
+	MeshCacheKey MeshCacheKey::FromSource(const std::filesystem::path& source, const uint32_t importFlags, const uint32_t vertexStride, const uint32_t processingFlags) {
+		MeshCacheKey key{};
+		key.sourceSize = std::filesystem::file_size(source);
+		key.sourceWriteTime = static_cast<int64_t>(std::filesystem::last_write_time(source).time_since_epoch().count());
+		key.importFlags = importFlags;
+		key.vertexStride = vertexStride;
+		key.processingFlags = processingFlags;
+		return key;
+	}
+
+	std::filesystem::path MeshCache::GetCachePath(const std::filesystem::path& source) {
+		std::filesystem::path cachePath = source;
+		cachePath += ".meshcache";
+		return cachePath;
+	}
+
+	bool MeshCache::Write(const std::filesystem::path& cachePath, const MeshCacheKey& key, const MeshCacheData& data) {
+		MeshCacheHeader header{};
+		header.magic = c_Magic;
+		header.version = c_Version;
+		header.sourceSize = key.sourceSize;
+		header.sourceWriteTime = key.sourceWriteTime;
+		header.importFlags = key.importFlags;
+		header.vertexStride = key.vertexStride;
+		header.processingFlags = key.processingFlags;
+
+		// Sections in file order, each one aligned.
+		struct SectionData {
+			MeshCacheSection* section;
+			const void* data;
+			uint64_t count;
+			uint64_t elementSize;
+		};
+		const SectionData sections[] = {
+			{&header.vertices, data.vertices, data.vertexCount, key.vertexStride},
+			{&header.indices, data.indices, data.indexCount, sizeof(uint32_t)},
+			{&header.meshes, data.meshes, data.meshCount, sizeof(SceneMesh)},
+			{&header.instances, data.instances, data.instanceCount, sizeof(SceneInstance)},
+		};
+		uint64_t offset = sizeof(MeshCacheHeader);
+		for (const SectionData& section: sections) {
+			offset = AlignUp(offset, c_SectionAlignment);
+			section.section->offset = offset;
+			section.section->count = section.count;
+			offset += section.count * section.elementSize;
+		}
+
+		return WriteFileAtomically(cachePath, [&header, &sections](std::ofstream& file) {
+			static constexpr char c_Padding[c_SectionAlignment]{};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			uint64_t written = sizeof(header);
+			for (const SectionData& section: sections) {
+				file.write(c_Padding, static_cast<std::streamsize>(section.section->offset - written));
+				file.write(static_cast<const char*>(section.data), static_cast<std::streamsize>(section.count * section.elementSize));
+				written = section.section->offset + section.count * section.elementSize;
+			}
+		});
+	}
+
+	bool MeshCache::Open(const std::filesystem::path& cachePath, const MeshCacheKey& key) {
+		Close();
+
+		if (!m_File.Open(cachePath) || m_File.GetSize() < sizeof(MeshCacheHeader)) {
+			Close();
+			return false;
+		}
+
+		MeshCacheHeader header{};
+		std::memcpy(&header, m_File.GetData(), sizeof(header));
+
+		const MeshCacheKey cachedKey{header.sourceSize, header.sourceWriteTime, header.importFlags, header.vertexStride, header.processingFlags};
+		if (header.magic != c_Magic || header.version != c_Version || cachedKey != key) {
+			Close();
+			return false;
+		}
+
+		const uint64_t fileSize = m_File.GetSize();
+		if (!IsSectionValid(header.vertices, key.vertexStride, fileSize) || !IsSectionValid(header.indices, sizeof(uint32_t), fileSize) ||
+			!IsSectionValid(header.meshes, sizeof(SceneMesh), fileSize) || !IsSectionValid(header.instances, sizeof(SceneInstance), fileSize)) {
+			Close();
+			return false;
+		}
+
+		m_Key = key;
+		m_Vertices = m_File.GetData() + header.vertices.offset;
+		m_VertexCount = header.vertices.count;
+		m_Indices = reinterpret_cast<const uint32_t*>(m_File.GetData() + header.indices.offset);
+		m_IndexCount = header.indices.count;
+		m_Meshes = reinterpret_cast<const SceneMesh*>(m_File.GetData() + header.meshes.offset);
+		m_MeshCount = header.meshes.count;
+		m_Instances = reinterpret_cast<const SceneInstance*>(m_File.GetData() + header.instances.offset);
+		m_InstanceCount = header.instances.count;
+		return true;
+	}
+
+	void MeshCache::Close() {
+		m_File.Close();
+		m_Key = {};
+		m_Vertices = nullptr;
+		m_VertexCount = 0;
+		m_Indices = nullptr;
+		m_IndexCount = 0;
+		m_Meshes = nullptr;
+		m_MeshCount = 0;
+		m_Instances = nullptr;
+		m_InstanceCount = 0;
+	}
+
+} // namespace Imagine::Core
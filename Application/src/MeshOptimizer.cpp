@@ -0,0 +1,341 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace Imagine::Core {
+
+	namespace {
+		/**
+		 * FIFO post-transform cache using timestamps: `time` only moves on a miss,
+		 * so a vertex is still cached while fewer than `size` misses happened since it was loaded.
+		 */
+		class FifoCache {
+		public:
+			FifoCache(const size_t vertexCount, const uint32_t size) : m_Timestamps(vertexCount, 0), m_Size(size), m_Time(size + 1) {}
+
+			// Returns true on a miss.
+			bool Access(const uint32_t vertex) {
+				if (m_Time - m_Timestamps[vertex] > m_Size) {
+					m_Timestamps[vertex] = m_Time++;
+					return true;
+				}
+				return false;
+			}
+
+			void Reset() {
+				// Pushing every timestamp out of the window is cheaper than clearing them.
+				m_Time += m_Size + 1;
+			}
+
+		private:
+			std::vector<uint64_t> m_Timestamps;
+			uint64_t m_Size;
+			uint64_t m_Time;
+		};
+
+		struct TriangleAdjacency {
+			// Triangles of vertex v are triangles[offsets[v]] to triangles[offsets[v + 1]].
+			std::vector<uint32_t> offsets{};
+			std::vector<uint32_t> triangles{};
+		};
+
+		TriangleAdjacency BuildAdjacency(const std::vector<uint32_t>& indices, const size_t vertexCount) {
+			TriangleAdjacency adjacency{};
+			adjacency.offsets.assign(vertexCount + 1, 0);
+			for (const uint32_t index: indices) {
+				++adjacency.offsets[index + 1];
+			}
+			std::partial_sum(adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin());
+
+			std::vector<uint32_t> cursors(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+			adjacency.triangles.resize(indices.size());
+			for (size_t i = 0; i < indices.size(); ++i) {
+				adjacency.triangles[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+			return adjacency;
+		}
+
+		void ValidateIndices(const std::vector<uint32_t>& indices, const size_t vertexCount) {
+			if (indices.size() % 3 != 0) {
+				throw std::runtime_error("the index count isn't a multiple of 3!");
+			}
+			for (const uint32_t index: indices) {
+				if (index >= vertexCount) {
+					throw std::runtime_error("index out of the vertex range!");
+				}
+			}
+		}
+
+		struct Vector3 {
+			double x{0.0}, y{0.0}, z{0.0};
+
+			Vector3 operator+(const Vector3& other) const { return {x + other.x, y + other.y, z + other.z}; }
+			Vector3 operator-(const Vector3& other) const { return {x - other.x, y - other.y, z - other.z}; }
+			Vector3 operator*(const double scale) const { return {x * scale, y * scale, z * scale}; }
+			[[nodiscard]] double Dot(const Vector3& other) const { return x * other.x + y * other.y + z * other.z; }
+			[[nodiscard]] Vector3 Cross(const Vector3& other) const { return {y * other.z - z * other.y, z * other.x - x * other.z, x * other.y - y * other.x}; }
+			[[nodiscard]] double Length() const { return std::sqrt(Dot(*this)); }
+		};
+	}
+
+	VertexCacheStatistics& VertexCacheStatistics::operator+=(const VertexCacheStatistics& other) {
+		transformedVertexCount += other.transformedVertexCount;
+		triangleCount += other.triangleCount;
+		vertexCount += other.vertexCount;
+		acmr = triangleCount == 0 ? 0.0 : static_cast<double>(transformedVertexCount) / static_cast<double>(triangleCount);
+		atvr = vertexCount == 0 ? 0.0 : static_cast<double>(transformedVertexCount) / static_cast<double>(vertexCount);
+		return *this;
+	}
+
+	VertexCacheStatistics MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& indices, const size_t vertexCount, const uint32_t cacheSize) {
+		ValidateIndices(indices, vertexCount);
+
+		VertexCacheStatistics statistics{};
+		FifoCache cache(vertexCount, cacheSize);
+		std::vector<bool> referenced(vertexCount, false);
+		for (const uint32_t index: indices) {
+			statistics.transformedVertexCount += cache.Access(index) ? 1 : 0;
+			if (!referenced[index]) {
+				referenced[index] = true;
+				++statistics.vertexCount;
+			}
+		}
+
+		statistics.triangleCount = indices.size() / 3;
+		statistics.acmr = statistics.triangleCount == 0 ? 0.0 : static_cast<double>(statistics.transformedVertexCount) / static_cast<double>(statistics.triangleCount);
+		statistics.atvr = statistics.vertexCount == 0 ? 0.0 : static_cast<double>(statistics.transformedVertexCount) / static_cast<double>(statistics.vertexCount);
+		return statistics;
+	}
+
+	void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, const size_t vertexCount, const uint32_t cacheSize) {
+		ValidateIndices(indices, vertexCount);
+		if (indices.empty()) {
+			return;
+		}
+
+		const TriangleAdjacency adjacency = BuildAdjacency(indices, vertexCount);
+		const size_t triangleCount = indices.size() / 3;
+
+		// Triangles not emitted yet, per vertex.
+		std::vector<uint32_t> liveTriangles(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v) {
+			liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+		}
+
+		std::vector<uint64_t> cacheTimestamps(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		// Recently used vertices, to restart next to the last triangles when the fan runs dry.
+		std::vector<uint32_t> deadEndStack{};
+		std::vector<uint32_t> candidates{};
+		std::vector<uint32_t> result{};
+		result.reserve(indices.size());
+
+		uint64_t time = cacheSize + 1;
+		size_t scanCursor = 0;
+		int64_t fanningVertex = 0;
+
+		while (fanningVertex >= 0) {
+			candidates.clear();
+
+			// Emit every remaining triangle around the fanning vertex.
+			const uint32_t vertex = static_cast<uint32_t>(fanningVertex);
+			for (uint32_t i = adjacency.offsets[vertex]; i < adjacency.offsets[vertex + 1]; ++i) {
+				const uint32_t triangle = adjacency.triangles[i];
+				if (emitted[triangle]) continue;
+				emitted[triangle] = true;
+
+				for (uint32_t corner = 0; corner < 3; ++corner) {
+					const uint32_t v = indices[triangle * 3 + corner];
+					result.push_back(v);
+					deadEndStack.push_back(v);
+					candidates.push_back(v);
+					--liveTriangles[v];
+					if (time - cacheTimestamps[v] > cacheSize) {
+						cacheTimestamps[v] = time++;
+					}
+				}
+			}
+
+			// Next fanning vertex: the candidate that will still be in the cache once its own fan is emitted, the oldest first.
+			fanningVertex = -1;
+			int64_t bestPriority = -1;
+			for (const uint32_t v: candidates) {
+				if (liveTriangles[v] == 0) continue;
+
+				int64_t priority = 0;
+				const uint64_t age = time - cacheTimestamps[v];
+				if (age + 2 * static_cast<uint64_t>(liveTriangles[v]) <= cacheSize) {
+					priority = static_cast<int64_t>(age);
+				}
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					fanningVertex = v;
+				}
+			}
+
+			if (fanningVertex >= 0) continue;
+
+			// Dead end: a recently used vertex with triangles left, or else the next one in index order.
+			while (!deadEndStack.empty()) {
+				const uint32_t v = deadEndStack.back();
+				deadEndStack.pop_back();
+				if (liveTriangles[v] > 0) {
+					fanningVertex = v;
+					break;
+				}
+			}
+			while (fanningVertex < 0 && scanCursor < vertexCount) {
+				if (liveTriangles[scanCursor] > 0) {
+					fanningVertex = static_cast<int64_t>(scanCursor);
+				}
+				++scanCursor;
+			}
+		}
+
+		indices = std::move(result);
+	}
+
+	void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const float* positions, const size_t vertexCount, const size_t positionStride, const uint32_t cacheSize, const double threshold) {
+		ValidateIndices(indices, vertexCount);
+		const size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0) {
+			return;
+		}
+
+		const auto* positionBytes = reinterpret_cast<const std::byte*>(positions);
+		const auto getPosition = [positionBytes, positionStride](const uint32_t vertex) {
+			float position[3];
+			std::memcpy(position, positionBytes + vertex * positionStride, sizeof(position));
+			return Vector3{position[0], position[1], position[2]};
+		};
+
+		// Hard boundaries: triangles missing the cache on every vertex, the cache order starts over there anyway.
+		std::vector<size_t> hardClusters{0};
+		{
+			FifoCache cache(vertexCount, cacheSize);
+			for (size_t triangle = 0; triangle < triangleCount; ++triangle) {
+				uint32_t misses = 0;
+				for (uint32_t corner = 0; corner < 3; ++corner) {
+					misses += cache.Access(indices[triangle * 3 + corner]) ? 1 : 0;
+				}
+				if (misses == 3 && triangle > 0) {
+					hardClusters.push_back(triangle);
+				}
+			}
+		}
+		hardClusters.push_back(triangleCount);
+
+		// Soft boundaries: split the hard clusters wherever the ACMR so far is close enough to the one of the whole cluster.
+		std::vector<size_t> clusters{};
+		{
+			FifoCache cache(vertexCount, cacheSize);
+			for (size_t c = 0; c + 1 < hardClusters.size(); ++c) {
+				const size_t begin = hardClusters[c];
+				const size_t end = hardClusters[c + 1];
+
+				cache.Reset();
+				uint64_t clusterMisses = 0;
+				for (size_t i = begin * 3; i < end * 3; ++i) {
+					clusterMisses += cache.Access(indices[i]) ? 1 : 0;
+				}
+				const double clusterAcmr = static_cast<double>(clusterMisses) / static_cast<double>(end - begin);
+
+				cache.Reset();
+				clusters.push_back(begin);
+				size_t subClusterBegin = begin;
+				uint64_t subClusterMisses = 0;
+				for (size_t triangle = begin; triangle < end; ++triangle) {
+					for (uint32_t corner = 0; corner < 3; ++corner) {
+						subClusterMisses += cache.Access(indices[triangle * 3 + corner]) ? 1 : 0;
+					}
+
+					const double subClusterAcmr = static_cast<double>(subClusterMisses) / static_cast<double>(triangle + 1 - subClusterBegin);
+					if (triangle + 1 < end && subClusterAcmr <= clusterAcmr * threshold) {
+						clusters.push_back(triangle + 1);
+						subClusterBegin = triangle + 1;
+						subClusterMisses = 0;
+						cache.Reset();
+					}
+				}
+			}
+		}
+		clusters.push_back(triangleCount);
+		const size_t clusterCount = clusters.size() - 1;
+
+		// Area weighted centroid of the mesh, and per cluster.
+		std::vector<Vector3> clusterCentroids(clusterCount);
+		std::vector<Vector3> clusterNormals(clusterCount);
+		Vector3 meshCentroid{};
+		double meshArea = 0.0;
+		for (size_t c = 0; c < clusterCount; ++c) {
+			double clusterArea = 0.0;
+			for (size_t triangle = clusters[c]; triangle < clusters[c + 1]; ++triangle) {
+				const Vector3 a = getPosition(indices[triangle * 3 + 0]);
+				const Vector3 b = getPosition(indices[triangle * 3 + 1]);
+				const Vector3 d = getPosition(indices[triangle * 3 + 2]);
+				// Twice the area, which doesn't matter for weights.
+				const Vector3 normal = (b - a).Cross(d - a);
+				const double area = normal.Length();
+
+				clusterCentroids[c] = clusterCentroids[c] + (a + b + d) * (area / 3.0);
+				clusterNormals[c] = clusterNormals[c] + normal;
+				clusterArea += area;
+			}
+
+			meshCentroid = meshCentroid + clusterCentroids[c];
+			meshArea += clusterArea;
+			clusterCentroids[c] = clusterArea > 0.0 ? clusterCentroids[c] * (1.0 / clusterArea) : getPosition(indices[clusters[c] * 3]);
+		}
+		meshCentroid = meshArea > 0.0 ? meshCentroid * (1.0 / meshArea) : Vector3{};
+
+		// Clusters far from the center and facing away from it are the most likely to occlude the others.
+		std::vector<double> sortKeys(clusterCount);
+		for (size_t c = 0; c < clusterCount; ++c) {
+			const double normalLength = clusterNormals[c].Length();
+			const Vector3 direction = normalLength > 0.0 ? clusterNormals[c] * (1.0 / normalLength) : Vector3{};
+			sortKeys[c] = (clusterCentroids[c] - meshCentroid).Dot(direction);
+		}
+
+		std::vector<size_t> order(clusterCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&sortKeys](const size_t lhs, const size_t rhs) { return sortKeys[lhs] > sortKeys[rhs]; });
+
+		std::vector<uint32_t> result{};
+		result.reserve(indices.size());
+		for (const size_t c: order) {
+			result.insert(result.end(), indices.begin() + static_cast<std::ptrdiff_t>(clusters[c] * 3), indices.begin() + static_cast<std::ptrdiff_t>(clusters[c + 1] * 3));
+		}
+		indices = std::move(result);
+	}
+
+	size_t MeshOptimizer::OptimizeVertexFetch(std::vector<uint32_t>& indices, void* vertices, const size_t vertexCount, const size_t vertexStride) {
+		ValidateIndices(indices, vertexCount);
+
+		constexpr uint32_t c_Unused = std::numeric_limits<uint32_t>::max();
+		std::vector<uint32_t> remap(vertexCount, c_Unused);
+		uint32_t nextVertex = 0;
+		for (uint32_t& index: indices) {
+			if (remap[index] == c_Unused) {
+				remap[index] = nextVertex++;
+			}
+			index = remap[index];
+		}
+
+		auto* bytes = static_cast<std::byte*>(vertices);
+		std::vector<std::byte> reordered(static_cast<size_t>(nextVertex) * vertexStride);
+		for (size_t v = 0; v < vertexCount; ++v) {
+			if (remap[v] != c_Unused) {
+				std::memcpy(reordered.data() + remap[v] * vertexStride, bytes + v * vertexStride, vertexStride);
+			}
+		}
+		std::memcpy(bytes, reordered.data(), reordered.size());
+
+		return nextVertex;
+	}
+
+} // namespace Imagine::Core
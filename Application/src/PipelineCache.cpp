@@ -0,0 +1,179 @@
+#include "PipelineCache.hpp"
+#include "AtomicFile.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <vector>
+
+namespace Imagine::Vulkan {
+
+	namespace {
+		// Followed by the driver data.
+		struct PipelineCacheFileHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint64_t dataSize;
+			uint64_t coldCreationNanoseconds;
+		};
+		static_assert(sizeof(PipelineCacheFileHeader) == 24, "The header layout is part of the file format.");
+
+		// VkPipelineCacheHeaderVersionOne, read field by field as the driver data has no alignment guarantee.
+		constexpr uint64_t c_DriverHeaderSize = 16 + VK_UUID_SIZE;
+
+		uint32_t ReadUInt32(const uint8_t* data) {
+			uint32_t value;
+			std::memcpy(&value, data, sizeof(value));
+			return value;
+		}
+
+		double ToMilliseconds(const std::chrono::nanoseconds duration) {
+			return std::chrono::duration<double, std::milli>(duration).count();
+		}
+	}
+
+	PipelineCache::~PipelineCache() {
+		Shutdown();
+	}
+
+	bool PipelineCache::Init(const VkPhysicalDevice physicalDevice, const VkDevice device, const std::filesystem::path& path) {
+		m_Device = device;
+		m_Path = path;
+		m_Statistics = {};
+		vkGetPhysicalDeviceProperties(physicalDevice, &m_Properties);
+
+		std::vector<uint8_t> data;
+		m_ColdReason = "no cache file";
+		if (std::ifstream file(m_Path, std::ios::binary | std::ios::ate); file.is_open()) {
+			const auto fileSize = static_cast<uint64_t>(file.tellg());
+			file.seekg(0);
+
+			PipelineCacheFileHeader header{};
+			m_ColdReason = "corrupted cache file";
+			if (fileSize >= sizeof(header) && file.read(reinterpret_cast<char*>(&header), sizeof(header))
+				&& header.magic == c_Magic && header.version == c_Version && header.dataSize == fileSize - sizeof(header)) {
+				// Kept whatever the driver data, a cache rebuilt from scratch is still a cold start.
+				m_Statistics.coldCreationTime = std::chrono::nanoseconds(header.coldCreationNanoseconds);
+
+				data.resize(header.dataSize);
+				if (!file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()))) {
+					data.clear();
+				} else if (!IsCompatible(data.data(), data.size())) {
+					m_ColdReason = "built for another device or driver";
+					data.clear();
+				}
+			}
+		}
+
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = data.size();
+		cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+		if (vkCreatePipelineCache(m_Device, &cacheInfo, nullptr, &m_Cache) != VK_SUCCESS) {
+			// The driver might still refuse data it wrote itself, start over rather than fail.
+			cacheInfo.initialDataSize = 0;
+			cacheInfo.pInitialData = nullptr;
+			data.clear();
+			m_ColdReason = "rejected by the driver";
+			if (vkCreatePipelineCache(m_Device, &cacheInfo, nullptr, &m_Cache) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create pipeline cache!");
+			}
+		}
+
+		m_Statistics.loadedBytes = data.size();
+		return !data.empty();
+	}
+
+	void PipelineCache::Shutdown() {
+		if (m_Device == VK_NULL_HANDLE) return;
+
+		vkDestroyPipelineCache(m_Device, m_Cache, nullptr);
+		m_Cache = VK_NULL_HANDLE;
+		m_Device = VK_NULL_HANDLE;
+	}
+
+	bool PipelineCache::IsCompatible(const uint8_t* data, const uint64_t size) const {
+		if (size < c_DriverHeaderSize) {
+			return false;
+		}
+
+		const uint32_t headerSize = ReadUInt32(data);
+		const uint32_t headerVersion = ReadUInt32(data + 4);
+		const uint32_t vendorID = ReadUInt32(data + 8);
+		const uint32_t deviceID = ReadUInt32(data + 12);
+		return headerSize >= c_DriverHeaderSize && headerSize <= size
+			   && headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			   && vendorID == m_Properties.vendorID
+			   && deviceID == m_Properties.deviceID
+			   && std::memcmp(data + 16, m_Properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+	bool PipelineCache::Save() const {
+		size_t dataSize = 0;
+		if (vkGetPipelineCacheData(m_Device, m_Cache, &dataSize, nullptr) != VK_SUCCESS) {
+			return false;
+		}
+		std::vector<uint8_t> data(dataSize);
+		if (vkGetPipelineCacheData(m_Device, m_Cache, &dataSize, data.data()) != VK_SUCCESS) {
+			return false;
+		}
+		data.resize(dataSize);
+
+		PipelineCacheFileHeader header{};
+		header.magic = c_Magic;
+		header.version = c_Version;
+		header.dataSize = data.size();
+		// The reference for the next warm starts.
+		header.coldCreationNanoseconds = static_cast<uint64_t>((IsWarm() ? m_Statistics.coldCreationTime : m_Statistics.startupCreationTime).count());
+
+		return Core::WriteFileAtomically(m_Path, [&header, &data](std::ofstream& file) {
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		});
+	}
+
+	void PipelineCache::EndStartup() {
+		std::lock_guard lock(m_StatisticsMutex);
+		m_Statistics.startupCreationTime = m_Statistics.creationTime;
+	}
+
+	VkResult PipelineCache::CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline& pipeline) {
+		const auto startTime = std::chrono::steady_clock::now();
+		const VkResult result = vkCreateGraphicsPipelines(m_Device, m_Cache, 1, &createInfo, nullptr, &pipeline);
+		const auto creationTime = std::chrono::steady_clock::now() - startTime;
+
+		std::lock_guard lock(m_StatisticsMutex);
+		m_Statistics.creationTime += creationTime;
+		++m_Statistics.pipelineCount;
+		return result;
+	}
+
+	VkResult PipelineCache::CreateComputePipeline(const VkComputePipelineCreateInfo& createInfo, VkPipeline& pipeline) {
+		const auto startTime = std::chrono::steady_clock::now();
+		const VkResult result = vkCreateComputePipelines(m_Device, m_Cache, 1, &createInfo, nullptr, &pipeline);
+		const auto creationTime = std::chrono::steady_clock::now() - startTime;
+
+		std::lock_guard lock(m_StatisticsMutex);
+		m_Statistics.creationTime += creationTime;
+		++m_Statistics.pipelineCount;
+		return result;
+	}
+
+	void PipelineCache::LogStatistics(std::ostream& stream) const {
+		const auto flags = stream.flags();
+		stream << std::fixed << std::setprecision(2);
+		stream << "[INFO] [PIPELINE] " << m_Statistics.pipelineCount << " pipelines created in " << ToMilliseconds(m_Statistics.creationTime) << " ms of compilation";
+		if (!IsWarm()) {
+			stream << " with a cold cache (" << m_ColdReason << ")." << std::endl;
+		} else if (m_Statistics.coldCreationTime.count() > 0) {
+			stream << " with a warm cache (" << m_Statistics.loadedBytes / 1024 << " KiB), "
+				   << ToMilliseconds(m_Statistics.coldCreationTime - m_Statistics.startupCreationTime) << " ms saved at startup on the "
+				   << ToMilliseconds(m_Statistics.coldCreationTime) << " ms of the last cold start." << std::endl;
+		} else {
+			stream << " with a warm cache (" << m_Statistics.loadedBytes / 1024 << " KiB)." << std::endl;
+		}
+		stream.flags(flags);
+	}
+
+} // namespace Imagine::Vulkan
@@ -0,0 +1,90 @@
+#include "PipelineVariantCache.hpp"
+
+#include <stdexcept>
+
+namespace Imagine::Vulkan {
+
+	PipelineVariantCache::~PipelineVariantCache() {
+		Shutdown();
+	}
+
+	void PipelineVariantCache::Init(const VkDevice device) {
+		m_Device = device;
+		m_Hits = 0;
+		m_Misses = 0;
+	}
+
+	void PipelineVariantCache::Shutdown() {
+		if (m_Device == VK_NULL_HANDLE) return;
+
+		for (const auto& [key, variant]: m_Variants) {
+			vkDestroyPipeline(m_Device, variant, nullptr);
+		}
+		m_Variants.clear();
+		m_Device = VK_NULL_HANDLE;
+	}
+
+	VkPipeline PipelineVariantCache::Get(const uint32_t pipeline, const std::span<const uint32_t> constants, const Builder& builder) {
+		Key key{pipeline, std::vector<uint32_t>(constants.begin(), constants.end())};
+		{
+			std::lock_guard lock(m_Mutex);
+			if (const auto it = m_Variants.find(key); it != m_Variants.end()) {
+				++m_Hits;
+				return it->second;
+			}
+		}
+
+		VkPipeline variant = Build(constants, builder);
+
+		std::lock_guard lock(m_Mutex);
+		++m_Misses;
+		const auto [it, inserted] = m_Variants.try_emplace(std::move(key), variant);
+		if (!inserted) {
+			vkDestroyPipeline(m_Device, variant, nullptr);
+		}
+		return it->second;
+	}
+
+	VkPipeline PipelineVariantCache::Build(const std::span<const uint32_t> constants, const Builder& builder) {
+		if (constants.empty()) {
+			return builder(nullptr);
+		}
+
+		std::vector<VkSpecializationMapEntry> entries(constants.size());
+		for (uint32_t i = 0; i < entries.size(); ++i) {
+			entries[i].constantID = i;
+			entries[i].offset = i * static_cast<uint32_t>(sizeof(uint32_t));
+			entries[i].size = sizeof(uint32_t);
+		}
+
+		VkSpecializationInfo specialization{};
+		specialization.mapEntryCount = static_cast<uint32_t>(entries.size());
+		specialization.pMapEntries = entries.data();
+		specialization.dataSize = constants.size_bytes();
+		specialization.pData = constants.data();
+		return builder(&specialization);
+	}
+
+	void PipelineVariantCache::Insert(const uint32_t pipeline, const std::span<const uint32_t> constants, const VkPipeline variant) {
+		std::lock_guard lock(m_Mutex);
+		if (!m_Variants.try_emplace(Key{pipeline, std::vector<uint32_t>(constants.begin(), constants.end())}, variant).second) {
+			throw std::runtime_error("pipeline variant already cached!");
+		}
+	}
+
+	std::vector<VkPipeline> PipelineVariantCache::Evict(const uint32_t pipeline) {
+		std::lock_guard lock(m_Mutex);
+		std::vector<VkPipeline> variants;
+		for (auto it = m_Variants.lower_bound(Key{pipeline, {}}); it != m_Variants.end() && it->first.first == pipeline;) {
+			variants.push_back(it->second);
+			it = m_Variants.erase(it);
+		}
+		return variants;
+	}
+
+	void PipelineVariantCache::LogStatistics(std::ostream& stream) const {
+		std::lock_guard lock(m_Mutex);
+		stream << "[INFO] [PIPELINE] " << m_Variants.size() << " pipeline variants, " << m_Hits << "/" << m_Hits + m_Misses << " requests served from the cache." << std::endl;
+	}
+
+} // namespace Imagine::Vulkan
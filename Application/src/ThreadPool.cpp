@@ -0,0 +1,134 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace Imagine::Core {
+
+	namespace {
+		// Shared by the caller of ParallelFor and its helpers, which may only start once every range is done.
+		struct ParallelForState {
+			const std::function<void(uint64_t begin, uint64_t end)>* function{nullptr};
+			uint64_t count{0};
+			uint64_t rangeSize{0};
+			uint64_t rangeCount{0};
+			std::atomic<uint64_t> nextRange{0};
+
+			std::mutex mutex{};
+			std::condition_variable condition{};
+			uint64_t completedRangeCount{0};
+			std::exception_ptr exception{};
+		};
+
+		// Process ranges until none is left to claim. `function` is only used for a claimed range, it outlives them.
+		void RunRanges(ParallelForState& state) {
+			while (true) {
+				const uint64_t range = state.nextRange.fetch_add(1);
+				if (range >= state.rangeCount) {
+					return;
+				}
+
+				const uint64_t begin = range * state.rangeSize;
+				const uint64_t end = std::min(state.count, begin + state.rangeSize);
+				std::exception_ptr exception{};
+				try {
+					(*state.function)(begin, end);
+				} catch (...) {
+					exception = std::current_exception();
+				}
+
+				std::lock_guard<std::mutex> lock(state.mutex);
+				if (exception && !state.exception) {
+					state.exception = exception;
+				}
+				if (++state.completedRangeCount == state.rangeCount) {
+					state.condition.notify_all();
+				}
+			}
+		}
+	}
+
+	ThreadPool::ThreadPool(const uint32_t threadCount) {
+		// hardware_concurrency() may return 0 when it can't tell.
+		const uint32_t count = threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+		m_Threads.reserve(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			m_Threads.emplace_back(&ThreadPool::WorkerLoop, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_Condition.notify_all();
+
+		for (std::thread& thread: m_Threads) {
+			thread.join();
+		}
+	}
+
+	void ThreadPool::ParallelFor(const uint64_t count, const uint64_t grainSize, const std::function<void(uint64_t begin, uint64_t end)>& function) {
+		if (count == 0) {
+			return;
+		}
+
+		// A few ranges per thread to balance uneven ranges, never smaller than the grain.
+		const uint64_t maxRangeCount = static_cast<uint64_t>(GetThreadCount() + 1) * 4;
+		const uint64_t rangeSize = std::max<uint64_t>(std::max<uint64_t>(grainSize, 1), (count + maxRangeCount - 1) / maxRangeCount);
+
+		auto state = std::make_shared<ParallelForState>();
+		state->function = &function;
+		state->count = count;
+		state->rangeSize = rangeSize;
+		state->rangeCount = (count + rangeSize - 1) / rangeSize;
+
+		// Ahead of the queued tasks, the caller is blocked until the ranges are done.
+		// A helper starting after the last range was claimed returns at once, nobody waits for it.
+		const uint64_t helperCount = std::min<uint64_t>(GetThreadCount(), state->rangeCount - 1);
+		for (uint64_t helper = 0; helper < helperCount; ++helper) {
+			Push([state]() { RunRanges(*state); }, true);
+		}
+
+		RunRanges(*state);
+
+		// Wait for the ranges still processed by the helpers.
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->condition.wait(lock, [&state]() { return state->completedRangeCount == state->rangeCount; });
+		if (state->exception) {
+			std::rethrow_exception(state->exception);
+		}
+	}
+
+	void ThreadPool::Push(std::function<void()> task, const bool first) {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (first) {
+				m_Tasks.push_front(std::move(task));
+			} else {
+				m_Tasks.push_back(std::move(task));
+			}
+		}
+		m_Condition.notify_one();
+	}
+
+	void ThreadPool::WorkerLoop() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Condition.wait(lock, [this]() { return m_Stopping || !m_Tasks.empty(); });
+				// Finish the queued tasks before stopping, someone might wait on their future.
+				if (m_Tasks.empty()) {
+					return;
+				}
+				task = std::move(m_Tasks.front());
+				m_Tasks.pop_front();
+			}
+			task();
+		}
+	}
+
+} // namespace Imagine::Core
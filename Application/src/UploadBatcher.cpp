@@ -0,0 +1,507 @@
+#include "UploadBatcher.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+namespace Imagine::Vulkan {
+
+	namespace {
+		VkDeviceSize AlignUp(const VkDeviceSize value, const VkDeviceSize alignment) {
+			return alignment <= 1 ? value : (value + alignment - 1) / alignment * alignment;
+		}
+
+		double ToMiB(const VkDeviceSize bytes) {
+			return static_cast<double>(bytes) / (1024.0 * 1024.0);
+		}
+	}
+
+	UploadBatcher::~UploadBatcher() {
+		Shutdown();
+	}
+
+	void UploadBatcher::Init(const VkDevice device, DeviceMemoryAllocator& allocator, const UploadQueue transferQueue, const UploadQueue ownerQueue, const VkDeviceSize ringSize, const VkDeviceSize copyAlignment) {
+		m_Device = device;
+		m_Allocator = &allocator;
+		m_TransferQueue = transferQueue;
+		m_OwnerQueue = ownerQueue;
+		m_RingSize = ringSize;
+		// vkCmdCopyBufferToImage wants offsets aligned on 4 and on the texel size, 16 covers every color format we use.
+		m_CopyAlignment = std::max<VkDeviceSize>(16, copyAlignment);
+		m_RingHead = 0;
+		m_RingTail = 0;
+		m_RingUsed = 0;
+		m_Statistics = {};
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = m_TransferQueue.familyIndex;
+		if (vkCreateCommandPool(m_Device, &poolInfo, nullptr, &m_CommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload command pool!");
+		}
+
+		std::array<VkCommandBuffer, c_MaxBatchesInFlight> commandBuffers{};
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = m_CommandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+		if (vkAllocateCommandBuffers(m_Device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate upload command buffers!");
+		}
+
+		std::array<VkCommandBuffer, c_MaxBatchesInFlight> ownerCommandBuffers{};
+		if (HasDedicatedTransferQueue()) {
+			poolInfo.queueFamilyIndex = m_OwnerQueue.familyIndex;
+			if (vkCreateCommandPool(m_Device, &poolInfo, nullptr, &m_OwnerCommandPool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create upload owner command pool!");
+			}
+
+			allocInfo.commandPool = m_OwnerCommandPool;
+			if (vkAllocateCommandBuffers(m_Device, &allocInfo, ownerCommandBuffers.data()) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate upload owner command buffers!");
+			}
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		for (uint32_t i = 0; i < c_MaxBatchesInFlight; ++i) {
+			m_Batches[i] = {};
+			m_Batches[i].commandBuffer = commandBuffers[i];
+			if (vkCreateFence(m_Device, &fenceInfo, nullptr, &m_Batches[i].fence) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create upload fence!");
+			}
+
+			if (HasDedicatedTransferQueue()) {
+				m_Batches[i].ownerCommandBuffer = ownerCommandBuffers[i];
+				if (vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_Batches[i].transferSemaphore) != VK_SUCCESS) {
+					throw std::runtime_error("failed to create upload semaphore!");
+				}
+			}
+		}
+
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = m_RingSize;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateBuffer(m_Device, &bufferInfo, nullptr, &m_RingBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create the staging ring buffer!");
+		}
+		m_RingMemory = m_Allocator->AllocateForBuffer(m_RingBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
+
+	void UploadBatcher::Shutdown() {
+		if (m_Device == VK_NULL_HANDLE) return;
+
+		WaitIdle();
+
+		for (Batch& batch: m_Batches) {
+			vkDestroyFence(m_Device, batch.fence, nullptr);
+			if (batch.transferSemaphore != VK_NULL_HANDLE) {
+				vkDestroySemaphore(m_Device, batch.transferSemaphore, nullptr);
+			}
+			batch = {};
+		}
+		// Destroying the pools frees the command buffers.
+		vkDestroyCommandPool(m_Device, m_CommandPool, nullptr);
+		m_CommandPool = VK_NULL_HANDLE;
+		if (m_OwnerCommandPool != VK_NULL_HANDLE) {
+			vkDestroyCommandPool(m_Device, m_OwnerCommandPool, nullptr);
+			m_OwnerCommandPool = VK_NULL_HANDLE;
+		}
+
+		vkDestroyBuffer(m_Device, m_RingBuffer, nullptr);
+		m_Allocator->Free(m_RingMemory);
+		m_RingBuffer = VK_NULL_HANDLE;
+
+		m_Device = VK_NULL_HANDLE;
+		m_Allocator = nullptr;
+		m_TransferQueue = {};
+		m_OwnerQueue = {};
+	}
+
+	StagingRegion UploadBatcher::Stage(const VkDeviceSize size, const VkDeviceSize alignment) {
+		const VkDeviceSize regionAlignment = std::max(alignment, m_CopyAlignment);
+		m_Statistics.stagedBytes += size;
+
+		if (size > m_RingSize) {
+			return CreateTemporaryBuffer(BeginBatch(), size);
+		}
+
+		VkDeviceSize offset = 0;
+		VkDeviceSize consumed = 0;
+		while (!TryAllocateInRing(size, regionAlignment, offset, consumed)) {
+			++m_Statistics.ringStallCount;
+			if (m_PendingBatches.empty()) {
+				// Only the batch being recorded holds the ring, flush it to get its space back.
+				Submit();
+			}
+			RetireOldest();
+		}
+
+		Batch& batch = BeginBatch();
+		batch.ringBytes += consumed;
+
+		StagingRegion region{};
+		region.buffer = m_RingBuffer;
+		region.offset = offset;
+		region.size = size;
+		region.mapped = static_cast<uint8_t*>(m_RingMemory.mapped) + offset;
+		return region;
+	}
+
+	VkCommandBuffer UploadBatcher::GetCommandBuffer() {
+		return BeginBatch().commandBuffer;
+	}
+
+	VkCommandBuffer UploadBatcher::GetOwnerCommandBuffer() {
+		Batch& batch = BeginBatch();
+		if (!HasDedicatedTransferQueue()) return batch.commandBuffer;
+
+		batch.usesOwnerQueue = true;
+		return batch.ownerCommandBuffer;
+	}
+
+	void UploadBatcher::TransferBufferOwnership(const VkBuffer buffer, const VkAccessFlags dstAccess, const VkPipelineStageFlags dstStage) {
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.buffer = buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		if (!HasDedicatedTransferQueue()) {
+			// Same family, a plain barrier is enough.
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = dstAccess;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			vkCmdPipelineBarrier(GetCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+			return;
+		}
+
+		barrier.srcQueueFamilyIndex = m_TransferQueue.familyIndex;
+		barrier.dstQueueFamilyIndex = m_OwnerQueue.familyIndex;
+
+		// Release: the destination access is ignored, the semaphore takes care of the execution dependency.
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(GetCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		// Acquire: the source access is ignored, the release already made the writes available.
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dstAccess;
+		vkCmdPipelineBarrier(GetOwnerCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		++m_Statistics.ownershipTransferCount;
+	}
+
+	void UploadBatcher::TransferImageOwnership(const VkImage image, const VkImageSubresourceRange& range, const VkImageLayout oldLayout, const VkImageLayout newLayout, const VkAccessFlags dstAccess, const VkPipelineStageFlags dstStage) {
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.image = image;
+		barrier.subresourceRange = range;
+		// Both halves of an ownership transfer must declare the same layout transition, it is only executed once.
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+
+		if (!HasDedicatedTransferQueue()) {
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = dstAccess;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			vkCmdPipelineBarrier(GetCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			return;
+		}
+
+		barrier.srcQueueFamilyIndex = m_TransferQueue.familyIndex;
+		barrier.dstQueueFamilyIndex = m_OwnerQueue.familyIndex;
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(GetCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dstAccess;
+		vkCmdPipelineBarrier(GetOwnerCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		++m_Statistics.ownershipTransferCount;
+	}
+
+	void UploadBatcher::UploadBuffer(const VkBuffer buffer, const VkDeviceSize bufferOffset, const void* data, const VkDeviceSize size) {
+		// Chunks of a quarter of the ring let the GPU consume the previous chunks while we fill the next ones.
+		const VkDeviceSize chunkSize = std::max<VkDeviceSize>(m_CopyAlignment, m_RingSize / 4);
+		const auto* bytes = static_cast<const uint8_t*>(data);
+
+		for (VkDeviceSize copied = 0; copied < size;) {
+			const VkDeviceSize chunk = std::min(chunkSize, size - copied);
+			const StagingRegion region = Stage(chunk);
+			memcpy(region.mapped, bytes + copied, static_cast<size_t>(chunk));
+
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = region.offset;
+			copyRegion.dstOffset = bufferOffset + copied;
+			copyRegion.size = chunk;
+			vkCmdCopyBuffer(GetCommandBuffer(), region.buffer, buffer, 1, &copyRegion);
+			++m_Statistics.copyCount;
+
+			copied += chunk;
+		}
+	}
+
+	void UploadBatcher::UploadImage(const VkImage image, const VkExtent3D extent, const VkImageAspectFlags aspect, const void* data, const VkDeviceSize size) {
+		const StagingRegion region = Stage(size);
+		memcpy(region.mapped, data, static_cast<size_t>(size));
+
+		VkBufferImageCopy copyRegion{};
+		copyRegion.bufferOffset = region.offset;
+		// 0 means tightly packed.
+		copyRegion.bufferRowLength = 0;
+		copyRegion.bufferImageHeight = 0;
+		copyRegion.imageSubresource.aspectMask = aspect;
+		copyRegion.imageSubresource.mipLevel = 0;
+		copyRegion.imageSubresource.baseArrayLayer = 0;
+		copyRegion.imageSubresource.layerCount = 1;
+		copyRegion.imageOffset = {0, 0, 0};
+		copyRegion.imageExtent = extent;
+
+		vkCmdCopyBufferToImage(GetCommandBuffer(), region.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+		++m_Statistics.copyCount;
+	}
+
+	UploadToken UploadBatcher::Submit() {
+		Batch& batch = m_Batches[m_CurrentBatch];
+		if (batch.state != BatchState::Recording) {
+			return UploadToken{m_LastSubmittedId};
+		}
+
+		// Make the transfers available to whatever reads the resources afterward, whichever submission it comes from.
+		// Recorded in the last command buffer to execute, so that it also covers the work done on the owner queue.
+		const VkCommandBuffer lastCommandBuffer = batch.usesOwnerQueue ? batch.ownerCommandBuffer : batch.commandBuffer;
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(lastCommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record upload command buffer!");
+		}
+
+		if (batch.usesOwnerQueue) {
+			if (vkEndCommandBuffer(batch.ownerCommandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to record upload owner command buffer!");
+			}
+			// The fence goes on the owner submission, it's the last one to complete.
+			SubmitCommandBuffer(m_TransferQueue.queue, batch.commandBuffer, VK_NULL_HANDLE, batch.transferSemaphore, VK_NULL_HANDLE);
+			SubmitCommandBuffer(m_OwnerQueue.queue, batch.ownerCommandBuffer, batch.transferSemaphore, VK_NULL_HANDLE, batch.fence);
+		} else {
+			SubmitCommandBuffer(m_TransferQueue.queue, batch.commandBuffer, VK_NULL_HANDLE, VK_NULL_HANDLE, batch.fence);
+		}
+
+		batch.state = BatchState::Pending;
+		m_PendingBatches.push_back(m_CurrentBatch);
+		m_LastSubmittedId = batch.id;
+		m_CurrentBatch = (m_CurrentBatch + 1) % c_MaxBatchesInFlight;
+		++m_Statistics.submittedBatchCount;
+
+		return UploadToken{batch.id};
+	}
+
+	void UploadBatcher::Poll() {
+		while (!m_PendingBatches.empty()) {
+			Batch& batch = m_Batches[m_PendingBatches.front()];
+			if (vkGetFenceStatus(m_Device, batch.fence) != VK_SUCCESS) break;
+			m_PendingBatches.pop_front();
+			RetireBatch(batch);
+		}
+	}
+
+	bool UploadBatcher::IsComplete(const UploadToken token) {
+		if (token.value <= m_LastCompletedId) return true;
+		Poll();
+		return token.value <= m_LastCompletedId;
+	}
+
+	void UploadBatcher::Wait(const UploadToken token) {
+		if (token.value > m_LastSubmittedId) {
+			Submit();
+		}
+		while (token.value > m_LastCompletedId && !m_PendingBatches.empty()) {
+			RetireOldest();
+		}
+	}
+
+	void UploadBatcher::WaitIdle() {
+		Wait(UploadToken{std::numeric_limits<uint64_t>::max()});
+	}
+
+	void UploadBatcher::LogStatistics(std::ostream& stream) const {
+		const auto flags = stream.flags();
+		stream << std::fixed << std::setprecision(2);
+		stream << "[INFO] [UPLOAD] " << m_Statistics.copyCount << " copies in " << m_Statistics.submittedBatchCount << " submissions"
+			   << " on " << (HasDedicatedTransferQueue() ? "a dedicated transfer queue" : "the graphics queue")
+			   << ", " << m_Statistics.ownershipTransferCount << " ownership transfers"
+			   << ", " << ToMiB(m_Statistics.stagedBytes) << " MiB staged through a " << ToMiB(m_RingSize) << " MiB ring"
+			   << ", " << m_Statistics.temporaryBufferCount << " temporary buffers"
+			   << ", " << m_Statistics.ringStallCount << " stalls" << std::endl;
+		stream.flags(flags);
+	}
+
+	UploadBatcher::Batch& UploadBatcher::BeginBatch() {
+		Batch& batch = m_Batches[m_CurrentBatch];
+		if (batch.state == BatchState::Recording) return batch;
+
+		if (batch.state == BatchState::Pending) {
+			// Every slot is in flight, the oldest is the one we want to reuse.
+			while (batch.state == BatchState::Pending) {
+				RetireOldest();
+			}
+		}
+
+		if (vkResetCommandBuffer(batch.commandBuffer, 0) != VK_SUCCESS) {
+			throw std::runtime_error("failed to reset upload command buffer!");
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording upload command buffer!");
+		}
+
+		if (HasDedicatedTransferQueue()) {
+			// Begun right away, but only submitted if something was recorded in it.
+			if (vkResetCommandBuffer(batch.ownerCommandBuffer, 0) != VK_SUCCESS) {
+				throw std::runtime_error("failed to reset upload owner command buffer!");
+			}
+			if (vkBeginCommandBuffer(batch.ownerCommandBuffer, &beginInfo) != VK_SUCCESS) {
+				throw std::runtime_error("failed to begin recording upload owner command buffer!");
+			}
+		}
+
+		batch.state = BatchState::Recording;
+		batch.usesOwnerQueue = false;
+		batch.id = m_NextBatchId++;
+		batch.ringBytes = 0;
+		return batch;
+	}
+
+	void UploadBatcher::RetireOldest() {
+		const uint32_t index = m_PendingBatches.front();
+		m_PendingBatches.pop_front();
+
+		Batch& batch = m_Batches[index];
+		if (vkWaitForFences(m_Device, 1, &batch.fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+			throw std::runtime_error("failed to wait for upload fence!");
+		}
+		RetireBatch(batch);
+	}
+
+	void UploadBatcher::RetireBatch(Batch& batch) {
+		vkResetFences(m_Device, 1, &batch.fence);
+
+		for (auto& [buffer, memory]: batch.temporaryBuffers) {
+			vkDestroyBuffer(m_Device, buffer, nullptr);
+			m_Allocator->Free(memory);
+		}
+		batch.temporaryBuffers.clear();
+
+		// Batches retire in submission order, which is also the order in which they consumed the ring.
+		m_RingTail = (m_RingTail + batch.ringBytes) % m_RingSize;
+		m_RingUsed -= batch.ringBytes;
+		batch.ringBytes = 0;
+
+		m_LastCompletedId = std::max(m_LastCompletedId, batch.id);
+		batch.state = BatchState::Idle;
+	}
+
+	bool UploadBatcher::TryAllocateInRing(const VkDeviceSize size, const VkDeviceSize alignment, VkDeviceSize& offset, VkDeviceSize& consumed) {
+		if (m_RingUsed == 0) {
+			// Restart from the beginning to limit the wrap-around waste.
+			m_RingHead = 0;
+			m_RingTail = 0;
+		}
+
+		const bool freeSpaceWraps = m_RingHead > m_RingTail || m_RingUsed == 0;
+		const VkDeviceSize alignedHead = AlignUp(m_RingHead, alignment);
+
+		if (freeSpaceWraps) {
+			// Free space is [head, size) then [0, tail).
+			if (alignedHead + size <= m_RingSize) {
+				offset = alignedHead;
+				consumed = alignedHead + size - m_RingHead;
+			} else if (size <= m_RingTail) {
+				offset = 0;
+				consumed = (m_RingSize - m_RingHead) + size;
+			} else {
+				return false;
+			}
+		} else {
+			// Free space is [head, tail), empty if head == tail.
+			if (alignedHead + size > m_RingTail) return false;
+			offset = alignedHead;
+			consumed = alignedHead + size - m_RingHead;
+		}
+
+		m_RingHead = (offset + size) % m_RingSize;
+		m_RingUsed += consumed;
+		return true;
+	}
+
+	void UploadBatcher::SubmitCommandBuffer(const VkQueue queue, const VkCommandBuffer commandBuffer, const VkSemaphore waitSemaphore, const VkSemaphore signalSemaphore, const VkFence fence) {
+		// The acquire barriers are the first commands of the owner command buffer, nothing can start before the transfer is done.
+		const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		if (waitSemaphore != VK_NULL_HANDLE) {
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &waitSemaphore;
+			submitInfo.pWaitDstStageMask = &waitStage;
+		}
+		if (signalSemaphore != VK_NULL_HANDLE) {
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &signalSemaphore;
+		}
+
+		if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload command buffer!");
+		}
+	}
+
+	StagingRegion UploadBatcher::CreateTemporaryBuffer(Batch& batch, const VkDeviceSize size) {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkBuffer buffer{VK_NULL_HANDLE};
+		if (vkCreateBuffer(m_Device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create temporary staging buffer!");
+		}
+		const MemoryAllocation memory = m_Allocator->AllocateForBuffer(buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		batch.temporaryBuffers.emplace_back(buffer, memory);
+		++m_Statistics.temporaryBufferCount;
+
+		StagingRegion region{};
+		region.buffer = buffer;
+		region.offset = 0;
+		region.size = size;
+		region.mapped = memory.mapped;
+		return region;
+	}
+
+} // namespace Imagine::Vulkan
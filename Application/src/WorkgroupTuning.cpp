@@ -0,0 +1,101 @@
+#include "WorkgroupTuning.hpp"
+#include "AtomicFile.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+
+namespace Imagine::Vulkan {
+
+	namespace {
+		constexpr const char* c_Header = "# Workgroup tuning, version ";
+
+		std::string ToHex(const DeviceUUID& device) {
+			std::ostringstream stream;
+			stream << std::hex << std::setfill('0');
+			for (const uint8_t byte: device) {
+				stream << std::setw(2) << static_cast<uint32_t>(byte);
+			}
+			return stream.str();
+		}
+
+		bool FromHex(const std::string& text, DeviceUUID& device) {
+			if (text.size() != device.size() * 2) {
+				return false;
+			}
+			for (size_t i = 0; i < device.size(); ++i) {
+				uint32_t byte = 0;
+				std::istringstream stream(text.substr(i * 2, 2));
+				if (!(stream >> std::hex >> byte)) {
+					return false;
+				}
+				device[i] = static_cast<uint8_t>(byte);
+			}
+			return true;
+		}
+	}
+
+	bool WorkgroupTuning::Load(const std::filesystem::path& path) {
+		m_Devices.clear();
+
+		std::ifstream file(path);
+		std::string line;
+		if (!file.is_open() || !std::getline(file, line) || line != c_Header + std::to_string(c_Version)) {
+			return false;
+		}
+
+		while (std::getline(file, line)) {
+			std::istringstream stream(line);
+			std::string uuid;
+			WorkgroupTuningResult result{};
+			DeviceUUID device{};
+			if (!(stream >> uuid >> result.particleCount >> result.workgroupSize >> result.dispatchMicroseconds) || !FromHex(uuid, device) || result.workgroupSize == 0) {
+				m_Devices.clear();
+				return false;
+			}
+			m_Devices[device].push_back(result);
+		}
+		return true;
+	}
+
+	bool WorkgroupTuning::Save(const std::filesystem::path& path) const {
+		return Core::WriteFileAtomically(path, [this](std::ofstream& file) {
+			file << c_Header << c_Version << '\n';
+			file << std::fixed << std::setprecision(3);
+			for (const auto& [device, results]: m_Devices) {
+				for (const WorkgroupTuningResult& result: results) {
+					file << ToHex(device) << ' ' << result.particleCount << ' ' << result.workgroupSize << ' ' << result.dispatchMicroseconds << '\n';
+				}
+			}
+		});
+	}
+
+	uint32_t WorkgroupTuning::Find(const DeviceUUID& device, const uint32_t particleCount) const {
+		const auto it = m_Devices.find(device);
+		if (it == m_Devices.end()) {
+			return 0;
+		}
+
+		// The closest by ratio, the counts being swept by powers of two.
+		uint32_t workgroupSize = 0;
+		double bestDistance = std::numeric_limits<double>::max();
+		for (const WorkgroupTuningResult& result: it->second) {
+			const double distance = std::abs(std::log2(static_cast<double>(std::max(result.particleCount, 1u))) - std::log2(static_cast<double>(std::max(particleCount, 1u))));
+			if (distance < bestDistance) {
+				bestDistance = distance;
+				workgroupSize = result.workgroupSize;
+			}
+		}
+		return workgroupSize;
+	}
+
+	void WorkgroupTuning::Set(const DeviceUUID& device, std::vector<WorkgroupTuningResult> results) {
+		m_Devices[device] = std::move(results);
+	}
+
+} // namespace Imagine::Vulkan
@@ -10,25 +10,52 @@
 // #define GLM_FORCE_LEFT_HANDED
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtx/hash.hpp>
 
 #include <algorithm> // Necessary for std::clamp
 #include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <cstdint> // Necessary for uint32_t
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <limits> // Necessary for std::numeric_limits
 #include <map>
 #include <optional>
 #include <set>
+#include <span>
 #include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "BindlessTextureTable.hpp"
+#include "CounterRandom.hpp"
+#include "DeviceMemoryAllocator.hpp"
+#include "FileWatcher.hpp"
 #include "Image.hpp"
+#include "IndexPacking.hpp"
+#include "MeshCache.hpp"
+#include "MeshOptimizer.hpp"
+#include "PipelineCache.hpp"
+#include "PipelineVariantCache.hpp"
+#include "Scene.hpp"
+#include "Shaders.hpp"
+#include "ThreadPool.hpp"
+#include "UploadBatcher.hpp"
+#include "WorkgroupTuning.hpp"
 
 #define TRYC_MSG(test, message)            \
 	if constexpr ((test) != true) {        \
@@ -54,15 +81,99 @@
 #include <assimp/Importer.hpp> // C++ importer interface
 #include <assimp/postprocess.h> // Post processing flags
 #include <assimp/scene.h> // Output data structure
-#include <random>
 
 static constexpr uint32_t WIDTH = 800;
 static constexpr uint32_t HEIGHT = 600;
 static constexpr uint16_t MAX_FRAMES_IN_FLIGHT = 2;
-static constexpr uint16_t PARTICLE_COUNT = 4096;
+static constexpr uint32_t DEFAULT_PARTICLE_COUNT = 4096;
+// Default workgroup sizes, local_size_x of shader.comp and cull.comp is their specialization constant 0.
+// The particle one is replaced by the size tuned on the device, if any.
+static constexpr uint32_t PARTICLE_WORKGROUP_SIZE = 256;
+static constexpr uint32_t CULLING_WORKGROUP_SIZE = 64;
+// Must match local_size_x and local_size_y in depth_reduce.comp.
+static constexpr uint32_t DEPTH_REDUCE_WORKGROUP_SIZE = 8;
+// Particles initialized per task: big enough to amortize the scheduling, small enough to keep every thread busy.
+static constexpr uint64_t PARTICLE_INIT_GRAIN_SIZE = 16384;
+static constexpr uint64_t VERTEX_PACKING_GRAIN_SIZE = 16384;
 
 static constexpr const char* const MODEL_PATH = "Assets/viking_room.obj";
 static constexpr const char* const TEXTURE_PATH = "Assets/viking_room.png";
+// Part of the mesh cache key, changing them invalidates the cache.
+static constexpr uint32_t MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenUVCoords | aiProcess_FlipUVs | aiProcess_SortByPType;
+// Processing done after the import, also part of the mesh cache key.
+static constexpr uint32_t MESH_PROCESSING_OPTIMIZED = 1u << 0;
+// Rebuilt whenever the device or the driver changes.
+static constexpr const char* const PIPELINE_CACHE_PATH = "pipelines.pipelinecache";
+// Written by --tune-workgroups, one entry per device.
+static constexpr const char* const WORKGROUP_TUNING_PATH = "workgroups.tuning";
+// The sweep of --tune-workgroups: every power of two workgroup size from the minimum to the device limit,
+// each timed over several dispatches and kept at its best run to filter out the noise.
+static constexpr uint32_t TUNING_MIN_WORKGROUP_SIZE = 16;
+static constexpr uint32_t TUNING_DISPATCH_COUNT = 16;
+static constexpr uint32_t TUNING_RUN_COUNT = 3;
+
+// Defined by the build, used by the shader hot-reload.
+#ifndef LVK_SHADER_SOURCE_DIR
+#define LVK_SHADER_SOURCE_DIR "Shaders"
+#endif
+#ifndef LVK_GLSLC_EXECUTABLE
+#define LVK_GLSLC_EXECUTABLE "glslc"
+#endif
+#ifndef LVK_GLSLC_OPTIONS
+#define LVK_GLSLC_OPTIONS "--target-env=vulkan1.2 -O"
+#endif
+
+// The shaders the pipelines are built from, indexing SHADER_SOURCES.
+enum class ShaderId : uint32_t {
+	ShaderVert,
+	ShaderFrag,
+	ShaderComp,
+	ParticleVert,
+	ParticleFrag,
+	CullComp,
+	DepthReduceComp,
+	DepthReduceMultisampledComp,
+	Count,
+};
+
+enum class PipelineId : uint32_t {
+	Graphics,
+	Compute,
+	Particle,
+	Culling,
+	DepthReduce,
+	DepthReduceMultisampled,
+};
+
+// A pipeline rebuilt by the shader hot-reload, with the specialization constants it was built with.
+struct RebuiltPipeline {
+	PipelineId id;
+	std::vector<uint32_t> constants;
+	VkPipeline pipeline;
+};
+
+struct ShaderSource {
+	// The name given to add_spirv_shader in Application/CMakeLists.txt.
+	const char* name;
+	// In LVK_SHADER_SOURCE_DIR.
+	const char* file;
+	// The extra glslc options given to add_spirv_shader.
+	const char* options;
+	std::span<const uint32_t> embedded;
+	// Rebuilt when the shader is reloaded.
+	PipelineId pipeline;
+};
+
+static constexpr std::array<ShaderSource, static_cast<size_t>(ShaderId::Count)> SHADER_SOURCES = {{
+	{"shader.vert", "shader.vert", "", Imagine::Vulkan::Shaders::c_ShaderVert, PipelineId::Graphics},
+	{"shader.frag", "shader.frag", "", Imagine::Vulkan::Shaders::c_ShaderFrag, PipelineId::Graphics},
+	{"shader.comp", "shader.comp", "", Imagine::Vulkan::Shaders::c_ShaderComp, PipelineId::Compute},
+	{"particle.vert", "particle.vert", "", Imagine::Vulkan::Shaders::c_ParticleVert, PipelineId::Particle},
+	{"particle.frag", "particle.frag", "", Imagine::Vulkan::Shaders::c_ParticleFrag, PipelineId::Particle},
+	{"cull.comp", "cull.comp", "", Imagine::Vulkan::Shaders::c_CullComp, PipelineId::Culling},
+	{"depth_reduce.comp", "depth_reduce.comp", "", Imagine::Vulkan::Shaders::c_DepthReduceComp, PipelineId::DepthReduce},
+	{"depth_reduce_ms.comp", "depth_reduce.comp", "-DMULTISAMPLED", Imagine::Vulkan::Shaders::c_DepthReduceMultisampledComp, PipelineId::DepthReduceMultisampled},
+}};
 
 static const std::vector<const char *> c_ValidationLayers = {"VK_LAYER_KHRONOS_validation",};
 static const std::vector<const char*> c_DeviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
@@ -72,10 +183,202 @@ static constexpr bool c_EnableValidationLayers = false;
 static constexpr bool c_EnableValidationLayers = true;
 #endif
 
+static constexpr uint32_t DEFAULT_HEADLESS_FRAME_COUNT = 1000;
+
+// Layout of the vertices in the GPU vertex buffer.
+enum class VertexFormat {
+	// Vertex, 32 bytes.
+	Float,
+	// PackedVertex, 16 bytes.
+	Packed,
+};
+
+struct ApplicationParameters {
+	// Render into offscreen images instead of a window. No surface, no swapchain, no present.
+	// Usable on GPU-less machines with a software implementation like lavapipe.
+	bool headless{false};
+	// Number of frames to render before exiting. 0 means "until the window is closed".
+	uint32_t frameCount{0};
+	// Number of simulated particles, limited by maxStorageBufferRange.
+	uint32_t particleCount{DEFAULT_PARTICLE_COUNT};
+	// Reorder the imported meshes for the vertex cache, overdraw and vertex fetch.
+	bool optimizeMeshes{true};
+	VertexFormat vertexFormat{VertexFormat::Packed};
+	// Copies of the whole scene laid out on a grid, each mesh being drawn for all of them at once.
+	uint32_t sceneCopies{1};
+	// Watch the shader sources and rebuild the pipelines using the ones that change.
+	bool hotReloadShaders{false};
+	// Specialization constants of the compute shaders, checked against the device limits.
+	// 0 uses the size tuned on the device, PARTICLE_WORKGROUP_SIZE if it never was.
+	uint32_t particleWorkgroupSize{0};
+	uint32_t cullingWorkgroupSize{CULLING_WORKGROUP_SIZE};
+	// Test the draws against the depth pyramid in the late culling phase, frustum culling only otherwise.
+	bool occlusionCulling{true};
+	// Time the particle simulation with every workgroup size, store the best one for the device and exit.
+	bool tuneWorkgroups{false};
+};
+
+static uint32_t parseUnsigned(const std::string& option, const char* value) {
+	TRY_MSG(value != nullptr, "missing value for " + option);
+	try {
+		const unsigned long long parsed = std::stoull(value);
+		TRY_MSG(parsed <= std::numeric_limits<uint32_t>::max(), "value too large for " + option);
+		return static_cast<uint32_t>(parsed);
+	} catch (const std::logic_error&) {
+		throw std::invalid_argument("invalid value '" + std::string(value) + "' for " + option);
+	}
+}
+
+static ApplicationParameters parseArguments(const int argc, char** argv) {
+	ApplicationParameters parameters{};
+	bool frameCountSet = false;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string argument = argv[i];
+		if (argument == "--headless") {
+			parameters.headless = true;
+		} else if (argument == "--frames") {
+			parameters.frameCount = parseUnsigned(argument, i + 1 < argc ? argv[++i] : nullptr);
+			frameCountSet = true;
+		} else if (argument == "--no-mesh-optimization") {
+			parameters.optimizeMeshes = false;
+		} else if (argument == "--vertex-format") {
+			const std::string format = i + 1 < argc ? argv[++i] : "";
+			if (format == "float") {
+				parameters.vertexFormat = VertexFormat::Float;
+			} else if (format == "packed") {
+				parameters.vertexFormat = VertexFormat::Packed;
+			} else {
+				throw std::invalid_argument("invalid value '" + format + "' for " + argument + ", expected 'float' or 'packed'");
+			}
+		} else if (argument == "--particles") {
+			parameters.particleCount = parseUnsigned(argument, i + 1 < argc ? argv[++i] : nullptr);
+		} else if (argument == "--copies") {
+			parameters.sceneCopies = parseUnsigned(argument, i + 1 < argc ? argv[++i] : nullptr);
+		} else if (argument == "--hot-reload") {
+			parameters.hotReloadShaders = true;
+		} else if (argument == "--particle-workgroup-size") {
+			parameters.particleWorkgroupSize = parseUnsigned(argument, i + 1 < argc ? argv[++i] : nullptr);
+		} else if (argument == "--culling-workgroup-size") {
+			parameters.cullingWorkgroupSize = parseUnsigned(argument, i + 1 < argc ? argv[++i] : nullptr);
+		} else if (argument == "--no-occlusion-culling") {
+			parameters.occlusionCulling = false;
+		} else if (argument == "--tune-workgroups") {
+			parameters.tuneWorkgroups = true;
+		} else {
+			throw std::invalid_argument("unknown argument '" + argument + "'");
+		}
+	}
+
+	// A headless run has no window to close, it always needs a frame budget.
+	if (parameters.headless && !frameCountSet) {
+		parameters.frameCount = DEFAULT_HEADLESS_FRAME_COUNT;
+	}
+	TRY_MSG(!parameters.headless || parameters.frameCount > 0, "a headless run needs at least one frame.");
+	TRY_MSG(parameters.particleCount > 0, "at least one particle is required.");
+	TRY_MSG(parameters.sceneCopies > 0, "at least one copy of the scene is required.");
+	TRY_MSG(parameters.cullingWorkgroupSize > 0, "a workgroup needs at least one invocation.");
+
+	return parameters;
+}
+
+// Compile a shader from its source with the glslc and the options of the build.
+// Returns nothing if it doesn't compile, glslc reports the errors on the standard error.
+static std::vector<uint32_t> compileShader(const ShaderSource& shader) {
+	const std::filesystem::path source = std::filesystem::path(LVK_SHADER_SOURCE_DIR) / shader.file;
+	// Unique to the process and the compilation, neither another instance nor another reload of the same shader writes it.
+	static std::atomic<uint32_t> s_CompilationCount{0};
+#ifdef _WIN32
+	const int processId = _getpid();
+#else
+	const int processId = static_cast<int>(getpid());
+#endif
+	const std::string outputName = std::string(shader.name) + "." + std::to_string(processId) + "." + std::to_string(s_CompilationCount++) + ".hotreload.spv";
+	const std::filesystem::path output = std::filesystem::temp_directory_path() / outputName;
+
+	std::string command = "\"" LVK_GLSLC_EXECUTABLE "\" " LVK_GLSLC_OPTIONS " " + std::string(shader.options) + " -o \"" + output.string() + "\" \"" + source.string() + "\"";
+#ifdef _WIN32
+	// cmd.exe strips the outer quotes of the command.
+	command = "\"" + command + "\"";
+#endif
+	if (std::system(command.c_str()) != 0) {
+		return {};
+	}
+
+	std::vector<uint32_t> code;
+	{
+		std::ifstream file(output, std::ios::ate | std::ios::binary);
+		if (!file.is_open()) {
+			return {};
+		}
+		const auto size = static_cast<size_t>(file.tellg());
+		code.resize(size / sizeof(uint32_t));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(code.data()), static_cast<std::streamsize>(code.size() * sizeof(uint32_t)));
+		if (!file || size % sizeof(uint32_t) != 0) {
+			code.clear();
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::remove(output, error);
+	return code;
+}
+
+// Bytecode wrapper living while a pipeline is created, destroyed whether the creation succeeds or throws:
+// a failed hot-reload keeps the application running and mustn't leak it.
+class ShaderModule {
+public:
+	ShaderModule(const VkDevice device, const std::span<const uint32_t> code) : m_Device(device) {
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size_bytes();
+		createInfo.pCode = code.data();
+
+		TRY_VK(vkCreateShaderModule(m_Device, &createInfo, nullptr, &m_Module));
+	}
+	~ShaderModule() {
+		vkDestroyShaderModule(m_Device, m_Module, nullptr);
+	}
+	ShaderModule(const ShaderModule&) = delete;
+	ShaderModule& operator=(const ShaderModule&) = delete;
+
+	[[nodiscard]] VkShaderModule get() const { return m_Module; }
+
+private:
+	VkDevice m_Device{VK_NULL_HANDLE};
+	VkShaderModule m_Module{VK_NULL_HANDLE};
+};
+
 struct Particle {
 	glm::vec2 position;
 	glm::vec2 velocity;
 	glm::vec4 color;
+
+	// The storage buffers are read directly as vertex buffers to draw the particles.
+	static VkVertexInputBindingDescription getBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(Particle);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+		attributeDescriptions[0].offset = offsetof(Particle, position);
+
+		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attributeDescriptions[1].offset = offsetof(Particle, color);
+
+		return attributeDescriptions;
+	}
 };
 
 struct Vertex {
@@ -106,36 +409,179 @@ struct Vertex {
 
 		attributeDescriptions[2].binding = 0;
 		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
 		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
 
 		return attributeDescriptions;
 	}
 };
 
-struct UniformBufferObject {
+// Half the size of Vertex. The positions are quantized in the bounds of their mesh, the vertex shader maps them back with the MeshData.
+struct PackedVertex {
+	// R16G16B16A16_UNORM, w is padding.
+	uint16_t pos[4];
+	// R8G8B8A8_UNORM
+	uint32_t color;
+	// R16G16_SFLOAT
+	uint32_t texCoord;
+
+	static PackedVertex pack(const Vertex& vertex, const glm::vec3& boundsMin, const glm::vec3& inverseExtent) {
+		PackedVertex packed{};
+		for (int axis = 0; axis < 3; ++axis) {
+			const float normalized = std::clamp((vertex.pos[axis] - boundsMin[axis]) * inverseExtent[axis], 0.0f, 1.0f);
+			packed.pos[axis] = static_cast<uint16_t>(std::lround(normalized * 65535.0f));
+		}
+		packed.color = glm::packUnorm4x8(glm::vec4(vertex.color, 1.0f));
+		packed.texCoord = glm::packHalf2x16(vertex.texCoord);
+		return packed;
+	}
+
+	static VkVertexInputBindingDescription getBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(PackedVertex);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return bindingDescription;
+	}
+
+	// Same locations and shader types as Vertex, the vertex input stage does the decoding.
+	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+		attributeDescriptions[0].offset = offsetof(PackedVertex, pos);
+
+		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+		attributeDescriptions[1].offset = offsetof(PackedVertex, color);
+
+		attributeDescriptions[2].binding = 0;
+		attributeDescriptions[2].location = 2;
+		attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+		attributeDescriptions[2].offset = offsetof(PackedVertex, texCoord);
+
+		return attributeDescriptions;
+	}
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay tightly packed.");
+
+// One vkCmdDrawIndexed over a range of the index buffer, each range having its own index type.
+struct IndexedDraw {
+	VkIndexType indexType{VK_INDEX_TYPE_UINT32};
+	VkDeviceSize indexOffset{0};
+	uint32_t indexCount{0};
+	int32_t vertexOffset{0};
+};
+
+// The draws of m_Draws used by one mesh of the scene.
+struct MeshDrawRange {
+	uint32_t firstDraw{0};
+	uint32_t drawCount{0};
+};
+
+// Per instance data of the scene.
+struct InstanceData {
 	glm::mat4 model;
+};
+
+// Per mesh data, indexed by DrawData::meshIndex.
+struct MeshData {
+	// Object space bounds, for the culling pass.
+	glm::vec4 boundsMin;
+	glm::vec4 boundsMax;
+	// Object space position = a_Position * positionScale + positionOffset: the packed positions are quantized against the bounds
+	// of their own mesh, a small mesh keeps its precision in a large scene. Identity for VertexFormat::Float.
+	glm::vec4 positionScale;
+	glm::vec4 positionOffset;
+};
+static_assert(sizeof(MeshData) == 64, "MeshData must match the std430 layout of shader.vert and cull.comp.");
+
+// Per material data, indexed by DrawData::materialIndex.
+struct MaterialData {
+	// Index in the bindless texture table.
+	uint32_t textureIndex{0};
+};
+
+// One instance of one index range. The culling pass writes the index of the visible ones in the instance slots of their command,
+// which shader.vert reads back with gl_InstanceIndex.
+struct DrawData {
+	uint32_t instanceIndex{0};
+	uint32_t meshIndex{0};
+	uint32_t materialIndex{0};
+	// The indirect command drawing every instance of the index range.
+	uint32_t commandIndex{0};
+};
+static_assert(sizeof(DrawData) == 16, "DrawData must match the std430 layout of shader.vert and cull.comp.");
+
+// Indirect commands sharing an index type, drawn by a single vkCmdDrawIndexedIndirect with the index buffer bound at offset 0.
+struct IndirectBatch {
+	VkIndexType indexType{VK_INDEX_TYPE_UINT32};
+	uint32_t firstCommand{0};
+	uint32_t commandCount{0};
+};
+
+// Per frame, shared by every draw.
+struct UniformBufferObject {
 	glm::mat4 view;
 	glm::mat4 proj;
 };
 
-struct ComputeUniformBuffer {
-	float deltaTime;
+// Per draw call, pushed in the command buffer instead of going through a descriptor.
+// The indirect commands of a call share it, what differs between them is in DrawData.
+struct DrawPushConstants {
+	// Scene to world.
+	glm::mat4 model;
+};
+static_assert(sizeof(DrawPushConstants) <= 128, "Vulkan only guarantees 128 bytes of push constants.");
+
+struct CullingUniformBuffer {
+	// proj * view * model, from the scene space to the clip space.
+	glm::mat4 viewProjection;
+	// Frustum planes in scene space (before DrawPushConstants::model), normals pointing inside.
+	glm::vec4 planes[6];
+	glm::vec2 depthPyramidSize;
+	uint32_t drawCount;
 };
 
-static std::vector<char> readFile(const std::filesystem::path& filename) {
-	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+// Two-phase occlusion culling, see recordCommandBuffer.
+enum class CullingPhase : uint32_t {
+	// Draws what was visible last frame.
+	Early = 0,
+	// Tests everything against the depth pyramid of the early pass and draws what it missed.
+	Late = 1,
+};
 
-	TRY_MSG(file.is_open(), "failed to open file!");
+struct DepthReducePushConstants {
+	glm::ivec2 inputSize;
+	glm::ivec2 outputSize;
+	int32_t sampleCount;
+};
 
-	const size_t fileSize = (size_t) file.tellg();
-	std::vector<char> buffer(fileSize);
+// Accumulated from the draw counts read back after each frame.
+struct CullingStatistics {
+	uint64_t frameCount{0};
+	uint64_t visibleDrawCount{0};
+	uint64_t totalDrawCount{0};
+	uint32_t lastVisibleDrawCount{0};
+	// Part of the visible draws found by the occlusion test of the late phase.
+	uint32_t lastLateDrawCount{0};
+};
 
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
+struct ComputeUniformBuffer {
+	float deltaTime;
+	// The last workgroups are only partially used, the shader discards the invocations past the count.
+	uint32_t particleCount;
+};
 
-	file.close();
-	return buffer;
+static uint32_t previousPowerOfTwo(const uint32_t value) {
+	uint32_t result = 1;
+	while (result * 2 <= value) {
+		result *= 2;
+	}
+	return result;
 }
 
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
@@ -158,9 +604,15 @@ struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> computeFamily;
 	std::optional<uint32_t> presentFamily;
+	// Transfer only family if the device has one, the graphics family otherwise.
+	std::optional<uint32_t> transferFamily;
+
+	[[nodiscard]] bool IsComplete(const bool requirePresent = true) const {
+		return graphicsFamily.has_value() && (presentFamily.has_value() || !requirePresent);
+	}
 
-	[[nodiscard]] bool IsComplete() const {
-		return graphicsFamily.has_value() && presentFamily.has_value();
+	[[nodiscard]] bool HasDedicatedTransfer() const {
+		return transferFamily.has_value() && graphicsFamily.has_value() && transferFamily.value() != graphicsFamily.value();
 	}
 
 	[[nodiscard]] bool GraphicsAndComputeAreSame() const {
@@ -197,24 +649,20 @@ struct SwapChainSupportDetails {
 
 class HelloTriangleApplication {
 public:
+	explicit HelloTriangleApplication(const ApplicationParameters& parameters) : m_Parameters(parameters) {}
+
 	void run() {
-		initWindow();
+		if (!m_Parameters.headless) {
+			initWindow();
+		}
 		initVulkan();
-		mainLoop();
+		if (m_Parameters.tuneWorkgroups) {
+			tuneParticleWorkgroupSize();
+		} else {
+			mainLoop();
+		}
 		cleanup();
 	}
-private: // Helper Function
-	VkShaderModule createShaderModule(const std::vector<char>& code) {
-		VkShaderModuleCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data()); // Only possible because the data is stored in an std::vector where the default allocator already ensures that the data satisfies the worst case alignment requirements.
-
-		VkShaderModule shaderModule;
-		TRY_VK(vkCreateShaderModule(m_Device, &createInfo, nullptr, &shaderModule));
-
-		return shaderModule;
-	}
 private:
 	static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
 		auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
@@ -233,20 +681,36 @@ private:
 	void initVulkan() {
 		createInstance();
 		setupDebugMessenger();
-		createSurface();
+		if (!m_Parameters.headless) {
+			createSurface();
+		}
 
 		pickPhysicalDevice();
 		createLogicalDevice();
-
-		createSwapChain();
+		m_Allocator.Init(m_PhysicalDevice, m_Device);
+		createUploadBatcher();
+		m_PipelineCache.Init(m_PhysicalDevice, m_Device, PIPELINE_CACHE_PATH);
+		m_PipelineVariants.Init(m_Device);
+		checkWorkgroupSizes();
+
+		if (m_Parameters.headless) {
+			createOffscreenTargets();
+		} else {
+			createSwapChain();
+		}
 		createImageViews();
 		createRenderPass();
 
 		createDescriptorSetLayout();
-		createGraphicsPipeline();
-
+		createTextureSampler();
+		createTextureTable();
 		createComputeDescriptorSetLayout();
-		createComputePipeline();
+		createCullingDescriptorSetLayout();
+		createDepthReduceDescriptorSetLayout();
+		createDepthPyramidSampler();
+
+		// The pipelines compile on the thread pool while the assets load.
+		startPipelineCompilation();
 
 		createCommandPool();
 
@@ -259,13 +723,24 @@ private:
 
 		createTextureImage();
 		createTextureImageView();
-		createTextureSampler();
+		// Let the GPU process the texture while we load the model.
+		m_Uploader.Submit();
 
 		loadModel();
+		replicateScene();
 		createVertexBuffer();
 		createIndexBuffer();
+		createInstanceBuffer();
+		createMeshBuffer();
+		createMaterialBuffer();
+		createDrawCommandBuffer();
+		// The uploads copied everything into the staging memory.
+		releaseModelData();
+		const Imagine::Vulkan::UploadToken uploadToken = m_Uploader.Submit();
 
 		createUniformBuffers();
+		// The visible draws are read by the graphics descriptor sets.
+		createCullingBuffers();
 		createDescriptorPool();
 		createDescriptorSets();
 
@@ -273,8 +748,24 @@ private:
 		createComputeDescriptorPool();
 		createComputeDescriptorSets();
 
+		createCullingDescriptorPool();
+		createCullingDescriptorSets();
+
 		createCommandBuffers();
 		createSyncObjects();
+
+		waitForPipelines();
+		if (m_Parameters.hotReloadShaders) {
+			initShaderHotReload();
+		}
+
+		// Tokens are ordered, waiting on the last one waits for every upload.
+		m_Uploader.Wait(uploadToken);
+		m_Uploader.LogStatistics(std::cout);
+		m_Allocator.LogStatistics(std::cout);
+		m_TextureTable.LogStatistics(std::cout);
+		m_PipelineCache.LogStatistics(std::cout);
+		m_PipelineVariants.LogStatistics(std::cout);
 	}
 
 	void pickPhysicalDevice() {
@@ -305,7 +796,10 @@ private:
 		QueueFamilyIndices indices = findQueueFamilies(m_PhysicalDevice);
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-		std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.computeFamily.value(), indices.presentFamily.value()};
+		std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.computeFamily.value(), indices.transferFamily.value()};
+		if (indices.presentFamily.has_value()) {
+			uniqueQueueFamilies.insert(indices.presentFamily.value());
+		}
 
 		float queuePriority = 1.0f;
 		for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -317,18 +811,40 @@ private:
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 
+		VkPhysicalDeviceFeatures supportedFeatures{};
+		vkGetPhysicalDeviceFeatures(m_PhysicalDevice, &supportedFeatures);
+		m_MultiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+		m_MaxDrawIndirectCount = m_MultiDrawIndirect ? properties.limits.maxDrawIndirectCount : 1;
+
 		VkPhysicalDeviceFeatures deviceFeatures{};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
 		deviceFeatures.sampleRateShading = VK_TRUE;
+		// The instance slots of each command start at its firstInstance in the visible draw buffer.
+		deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+		deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+
+		// The bindless texture table, checked by rateDeviceSuitability.
+		VkPhysicalDeviceVulkan12Features features12{};
+		features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		features12.descriptorIndexing = VK_TRUE;
+		features12.runtimeDescriptorArray = VK_TRUE;
+		features12.descriptorBindingPartiallyBound = VK_TRUE;
+		features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
 
 		VkDeviceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		createInfo.pNext = &features12;
 
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(c_DeviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = c_DeviceExtensions.data();
+		const std::vector<const char*> deviceExtensions = getRequiredDeviceExtensions();
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
 		createInfo.pEnabledFeatures = &deviceFeatures;
 
@@ -344,7 +860,10 @@ private:
 
 		vkGetDeviceQueue(m_Device, indices.graphicsFamily.value(), 0, &m_GraphicsQueue);
 		vkGetDeviceQueue(m_Device, indices.computeFamily.value(), 0, &m_ComputeQueue);
-		vkGetDeviceQueue(m_Device, indices.presentFamily.value(), 0, &m_PresentQueue);
+		vkGetDeviceQueue(m_Device, indices.transferFamily.value(), 0, &m_TransferQueue);
+		if (indices.presentFamily.has_value()) {
+			vkGetDeviceQueue(m_Device, indices.presentFamily.value(), 0, &m_PresentQueue);
+		}
 	}
 
 	void createSurface() {
@@ -404,6 +923,23 @@ private:
 		m_SwapChainExtent = extent;
 	}
 
+	// Headless replacement of the swapchain: the render pass resolves into our own images, one per frame in flight.
+	void createOffscreenTargets() {
+		m_SwapChainImageFormat = findSupportedFormat(
+			{VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_UNORM},
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT
+		);
+		m_SwapChainExtent = {WIDTH, HEIGHT};
+
+		m_SwapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+		m_OffscreenImagesMemory.resize(MAX_FRAMES_IN_FLIGHT);
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			// Transfer source so the frames can be read back or blitted for inspection.
+			createImage(m_SwapChainExtent.width, m_SwapChainExtent.height, 1, VK_SAMPLE_COUNT_1_BIT, m_SwapChainImageFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_SwapChainImages[i], m_OffscreenImagesMemory[i]);
+		}
+	}
+
 	void createImageViews() {
 		m_SwapChainImageViews.resize(m_SwapChainImages.size());
 
@@ -413,17 +949,25 @@ private:
 	}
 
 	void createRenderPass() {
+		m_RenderPass = createScenePass(CullingPhase::Early);
+		// Compatible with the early pass: the pipelines and framebuffers are shared.
+		m_LateRenderPass = createScenePass(CullingPhase::Late);
+	}
+
+	// The early pass clears the attachments and keeps the depth for the depth pyramid, the late pass continues on top of it.
+	VkRenderPass createScenePass(const CullingPhase phase) {
+		const bool late = phase == CullingPhase::Late;
 		VkAttachmentDescription colorAttachment{};
 		colorAttachment.format = m_SwapChainImageFormat;
 		colorAttachment.samples = m_MsaaSamples; // no multisampling yet
 		// Color & Depth are the same load/store. Just don't use depth yet
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.loadOp = late ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
 		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.initialLayout = late ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
 		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // With Msaa, we cannot present the image directly and need to resolve it first.
 
 		// Render subpass
@@ -434,12 +978,13 @@ private:
 		VkAttachmentDescription depthAttachment{};
 		depthAttachment.format = findDepthFormat();
 		depthAttachment.samples = m_MsaaSamples;
-		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.loadOp = late ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+		// The depth of the early pass is read to build the depth pyramid.
+		depthAttachment.storeOp = late ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
 		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.initialLayout = late ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+		depthAttachment.finalLayout = late ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
 		// Render subpass
 		VkAttachmentReference depthAttachmentRef{};
@@ -455,7 +1000,8 @@ private:
 		colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		// Nothing presents the offscreen images, keep them ready to be copied out instead.
+		colorAttachmentResolve.finalLayout = m_Parameters.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 		VkAttachmentReference colorAttachmentResolveRef{};
 		colorAttachmentResolveRef.attachment = 2;
@@ -468,13 +1014,26 @@ private:
 		subpass.pDepthStencilAttachment = &depthAttachmentRef;
 		subpass.pResolveAttachments = &colorAttachmentResolveRef;
 
-		VkSubpassDependency dependency{};
+		// The depth pyramid reads the depth attachment in a compute shader, before and after the passes.
+		std::array<VkSubpassDependency, 2> dependencies{};
+		VkSubpassDependency& dependency = dependencies[0];
 		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.srcAccessMask = 0;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependency.srcAccessMask = late ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0;
 		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		if (late) {
+			dependency.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+		}
+
+		VkSubpassDependency& depthDependency = dependencies[1];
+		depthDependency.srcSubpass = 0;
+		depthDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+		depthDependency.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		depthDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthDependency.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		depthDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
 		std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
 
@@ -486,10 +1045,12 @@ private:
 		renderPassInfo.pSubpasses = &subpass;
 
 		// Add dependency of the render pass to the SwapChain read color stage.
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
+		renderPassInfo.dependencyCount = late ? 1 : static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
 
-		TRY_VK(vkCreateRenderPass(m_Device, &renderPassInfo, nullptr, &m_RenderPass))
+		VkRenderPass renderPass{VK_NULL_HANDLE};
+		TRY_VK(vkCreateRenderPass(m_Device, &renderPassInfo, nullptr, &renderPass))
+		return renderPass;
 	}
 
 	void createDescriptorSetLayout() {
@@ -500,15 +1061,47 @@ private:
 		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 		uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
 
-		// Add Image Sampler to be able to access the image from the fragment shader.
-		VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-		samplerLayoutBinding.binding = 1;
-		samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		samplerLayoutBinding.descriptorCount = 1;
-		samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-		samplerLayoutBinding.pImmutableSamplers = nullptr;
-
-		std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
+		// The materials, giving the texture of each draw. The textures themselves are in the bindless table (set 1).
+		VkDescriptorSetLayoutBinding materialLayoutBinding{};
+		materialLayoutBinding.binding = 1;
+		materialLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		materialLayoutBinding.descriptorCount = 1;
+		materialLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		materialLayoutBinding.pImmutableSamplers = nullptr;
+
+		// Transforms of every instance of the scene.
+		VkDescriptorSetLayoutBinding instanceLayoutBinding{};
+		instanceLayoutBinding.binding = 2;
+		instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		instanceLayoutBinding.descriptorCount = 1;
+		instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		instanceLayoutBinding.pImmutableSamplers = nullptr;
+
+		// Per draw data.
+		VkDescriptorSetLayoutBinding drawDataLayoutBinding{};
+		drawDataLayoutBinding.binding = 3;
+		drawDataLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		drawDataLayoutBinding.descriptorCount = 1;
+		drawDataLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		drawDataLayoutBinding.pImmutableSamplers = nullptr;
+
+		// The draws visible this frame, indexed with gl_InstanceIndex.
+		VkDescriptorSetLayoutBinding visibleDrawLayoutBinding{};
+		visibleDrawLayoutBinding.binding = 4;
+		visibleDrawLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		visibleDrawLayoutBinding.descriptorCount = 1;
+		visibleDrawLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		visibleDrawLayoutBinding.pImmutableSamplers = nullptr;
+
+		// The dequantization of the positions of each mesh.
+		VkDescriptorSetLayoutBinding meshLayoutBinding{};
+		meshLayoutBinding.binding = 5;
+		meshLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		meshLayoutBinding.descriptorCount = 1;
+		meshLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		meshLayoutBinding.pImmutableSamplers = nullptr;
+
+		std::array<VkDescriptorSetLayoutBinding, 6> bindings = {uboLayoutBinding, materialLayoutBinding, instanceLayoutBinding, drawDataLayoutBinding, visibleDrawLayoutBinding, meshLayoutBinding};
 
 		VkDescriptorSetLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -519,36 +1112,53 @@ private:
 	}
 
 	void createGraphicsPipeline() {
+		// ----- Create the Pipeline Layout. Used to specify the uniform and other runtime-editable variables.
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		// Set 0 is per frame, set 1 the texture table shared by every frame.
+		const std::array<VkDescriptorSetLayout, 2> setLayouts = {m_DescriptorSetLayout, m_TextureTable.GetDescriptorSetLayout()};
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+		// The per draw data, no descriptor or memory update needed to change it.
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(DrawPushConstants);
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		TRY_VK(vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, nullptr, &m_PipelineLayout));
 
-		// ----- Read pre-compiled SPIR-V ByteCode
-		const std::vector<char> fragShaderCode = readFile("Shaders/shader.frag.spv");
-		const std::vector<char> vertShaderCode  = readFile("Shaders/shader.vert.spv");
+		m_GraphicsPipeline = getPipeline(PipelineId::Graphics);
+	}
 
-		// ----- Create Vulkan wrapper around the bytecode.
+	// The build functions only create the pipeline, from the variant cache or the shader hot-reload on a worker thread.
+	VkPipeline buildGraphicsPipeline() {
+		// ----- Create Vulkan wrapper around the SPIR-V ByteCode.
 		// Only used to compile and link. Can be destroyed afterward.
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+		const ShaderModule vertShaderModule(m_Device, shaderCode(ShaderId::ShaderVert));
+		const ShaderModule fragShaderModule(m_Device, shaderCode(ShaderId::ShaderFrag));
 
 
 		// ----- Shader Stages Creation
 		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
 		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertShaderStageInfo.module = vertShaderModule;
+		vertShaderStageInfo.module = vertShaderModule.get();
 		vertShaderStageInfo.pName = "main";
 		vertShaderStageInfo.pSpecializationInfo = nullptr; // Used to set constant values at shader compilation to use like sort of define that will simplify and optimize the code.
 
 		VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
 		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragShaderStageInfo.module = fragShaderModule;
+		fragShaderStageInfo.module = fragShaderModule.get();
 		fragShaderStageInfo.pName = "main";
 		fragShaderStageInfo.pSpecializationInfo = nullptr; // Used to set constant values at shader compilation to use like sort of define that will simplify and optimize the code.
 
 		VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
-		auto bindingDescription = Vertex::getBindingDescription();
-		auto attributeDescriptions = Vertex::getAttributeDescriptions();
+		const bool packedVertices = m_Parameters.vertexFormat == VertexFormat::Packed;
+		auto bindingDescription = packedVertices ? PackedVertex::getBindingDescription() : Vertex::getBindingDescription();
+		auto attributeDescriptions = packedVertices ? PackedVertex::getAttributeDescriptions() : Vertex::getAttributeDescriptions();
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 		vertexInputInfo.vertexBindingDescriptionCount = 1;
@@ -655,15 +1265,6 @@ private:
 		colorBlending.blendConstants[2] = 0.0f; // Optional
 		colorBlending.blendConstants[3] = 0.0f; // Optional
 
-		// ----- Create the Pipeline Layout. Used to specify the uniform and other runtime-editable variables.
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 1; // Optional
-		pipelineLayoutInfo.pSetLayouts = &m_DescriptorSetLayout; // Optional
-		pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-		pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-		TRY_VK(vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, nullptr, &m_PipelineLayout));
-
 		VkPipelineDepthStencilStateCreateInfo depthStencil{};
 		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 		depthStencil.depthTestEnable = VK_TRUE;
@@ -705,94 +1306,622 @@ private:
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
 		pipelineInfo.basePipelineIndex = -1; // Optional
 
-		TRY_VK(vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_GraphicsPipeline))
-
-		// ----- CLeanup of the bytecode wrapper.
-		vkDestroyShaderModule(m_Device, fragShaderModule, nullptr);
-		vkDestroyShaderModule(m_Device, vertShaderModule, nullptr);
+		VkPipeline pipeline{VK_NULL_HANDLE};
+		TRY_VK(m_PipelineCache.CreateGraphicsPipeline(pipelineInfo, pipeline))
+		return pipeline;
 	}
 
 	void createComputePipeline() {
-		const std::vector<char> computeShaderCode = readFile("Shaders/shader.comp.spv");
+		// The layout must exist before the pipeline using it.
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &m_ComputeDescriptorSetLayout;
+
+		TRY_VK(vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, nullptr, &m_ComputePipelineLayout))
+
+		m_ComputePipeline = getPipeline(PipelineId::Compute);
+	}
 
-		VkShaderModule computeShaderModule = createShaderModule(computeShaderCode);
+	VkPipeline buildComputePipeline(const VkSpecializationInfo* specialization) {
+		const ShaderModule computeShaderModule(m_Device, shaderCode(ShaderId::ShaderComp));
 
 		VkPipelineShaderStageCreateInfo computeShaderStageInfo{};
 		computeShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		computeShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-		computeShaderStageInfo.module = computeShaderModule;
+		computeShaderStageInfo.module = computeShaderModule.get();
 		computeShaderStageInfo.pName = "main";
-		computeShaderStageInfo.pSpecializationInfo = nullptr; // Used to set constant values at shader compilation to use like sort of define that will simplify and optimize the code.
+		computeShaderStageInfo.pSpecializationInfo = specialization; // The workgroup size.
 
 		VkComputePipelineCreateInfo pipelineInfo{};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
 		pipelineInfo.layout = m_ComputePipelineLayout;
 		pipelineInfo.stage = computeShaderStageInfo;
 
-		TRY_VK(vkCreateComputePipelines(m_Device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_ComputePipeline))
+		VkPipeline pipeline{VK_NULL_HANDLE};
+		TRY_VK(m_PipelineCache.CreateComputePipeline(pipelineInfo, pipeline))
+		return pipeline;
+	}
+
+	void createCullingPipeline() {
+		// The CullingPhase.
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(uint32_t);
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &m_ComputeDescriptorSetLayout;
+		pipelineLayoutInfo.pSetLayouts = &m_CullingDescriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-		TRY_VK(vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, nullptr, &m_ComputePipelineLayout))
+		TRY_VK(vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, nullptr, &m_CullingPipelineLayout))
+
+		m_CullingPipeline = getPipeline(PipelineId::Culling);
 	}
 
-	void createFramebuffers() {
-		m_SwapChainFramebuffers.resize(m_SwapChainImageViews.size());
+	VkPipeline buildCullingPipeline(const VkSpecializationInfo* specialization) {
+		const ShaderModule cullingShaderModule(m_Device, shaderCode(ShaderId::CullComp));
 
-		for (int i = 0; i < m_SwapChainImageViews.size(); ++i) {
-			std::array<VkImageView, 3> attachments = {
-				m_ColorImageView, // Only possible due the way we built the semaphore beforehand.
-				m_DepthImageView, // Only possible due the way we built the semaphore beforehand.
-				m_SwapChainImageViews[i],
-			};
+		VkPipelineShaderStageCreateInfo cullingShaderStageInfo{};
+		cullingShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		cullingShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		cullingShaderStageInfo.module = cullingShaderModule.get();
+		cullingShaderStageInfo.pName = "main";
+		cullingShaderStageInfo.pSpecializationInfo = specialization; // The workgroup size and the occlusion culling toggle.
 
-			VkFramebufferCreateInfo framebufferInfo{};
-			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			framebufferInfo.renderPass = m_RenderPass;
-			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-			framebufferInfo.pAttachments = attachments.data();
-			framebufferInfo.width = m_SwapChainExtent.width;
-			framebufferInfo.height = m_SwapChainExtent.height;
-			framebufferInfo.layers = 1;
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.layout = m_CullingPipelineLayout;
+		pipelineInfo.stage = cullingShaderStageInfo;
 
-			TRY_VK(vkCreateFramebuffer(m_Device, &framebufferInfo, nullptr, &m_SwapChainFramebuffers[i]));
-		}
+		VkPipeline pipeline{VK_NULL_HANDLE};
+		TRY_VK(m_PipelineCache.CreateComputePipeline(pipelineInfo, pipeline))
+		return pipeline;
 	}
 
-	void createCommandPool() {
-		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(m_PhysicalDevice);
-
-		VkCommandPoolCreateInfo poolInfo{};
-		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+	void createParticlePipeline() {
+		// No descriptor, everything comes from the vertex buffer.
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		TRY_VK(vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, nullptr, &m_ParticlePipelineLayout));
 
-		TRY_VK(vkCreateCommandPool(m_Device, &poolInfo, nullptr, &m_CommandPool));
+		m_ParticlePipeline = getPipeline(PipelineId::Particle);
 	}
 
-	void createColorResources() {
-		VkFormat colorFormat = m_SwapChainImageFormat;
-		createImage(m_SwapChainExtent.width, m_SwapChainExtent.height, 1, m_MsaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_ColorImage, m_ColorImageMemory);
-		m_ColorImageView = createImageView(m_ColorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
-	}
+	VkPipeline buildParticlePipeline() {
+		const ShaderModule vertShaderModule(m_Device, shaderCode(ShaderId::ParticleVert));
+		const ShaderModule fragShaderModule(m_Device, shaderCode(ShaderId::ParticleFrag));
+
+		VkPipelineShaderStageCreateInfo shaderStages[2]{};
+		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStages[0].module = vertShaderModule.get();
+		shaderStages[0].pName = "main";
+		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStages[1].module = fragShaderModule.get();
+		shaderStages[1].pName = "main";
+
+		auto bindingDescription = Particle::getBindingDescription();
+		auto attributeDescriptions = Particle::getAttributeDescriptions();
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputInfo.vertexBindingDescriptionCount = 1;
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
-	void createDepthResources() {
-		VkFormat depthFormat = findDepthFormat();
-		createImage(m_SwapChainExtent.width, m_SwapChainExtent.height, 1, m_MsaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_DepthImage, m_DepthImageMemory);
-		m_DepthImageView = createImageView(m_DepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+		// One point per particle.
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+		inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-		// Can be skipped as it will be done at the same time as the render pass. Just writting it here for completeness.
-		// transitionImageLayout(m_DepthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, 1);
-	}
+		std::vector<VkDynamicState> dynamicStates = {
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+		};
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+		dynamicState.pDynamicStates = dynamicStates.data();
 
-	void createTextureImage() {
-		Imagine::Core::Image<uint8_t> image;
-		{
-			int texWidth, texHeight, texChannels;
-			stbi_uc* pixels = stbi_load(TEXTURE_PATH, &texWidth, &texHeight, &texChannels, 4);
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.scissorCount = 1;
+
+		VkPipelineRasterizationStateCreateInfo rasterizer{};
+		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer.lineWidth = 1.0f;
+		rasterizer.cullMode = VK_CULL_MODE_NONE;
+		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+		// Must match the render pass, even if points don't benefit from it.
+		VkPipelineMultisampleStateCreateInfo multisampling{};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.rasterizationSamples = m_MsaaSamples;
+		multisampling.sampleShadingEnable = VK_FALSE;
+
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		colorBlendAttachment.blendEnable = VK_FALSE;
+
+		VkPipelineColorBlendStateCreateInfo colorBlending{};
+		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.logicOpEnable = VK_FALSE;
+		colorBlending.attachmentCount = 1;
+		colorBlending.pAttachments = &colorBlendAttachment;
+
+		// Drawn over the scene, as an overlay.
+		VkPipelineDepthStencilStateCreateInfo depthStencil{};
+		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencil.depthTestEnable = VK_FALSE;
+		depthStencil.depthWriteEnable = VK_FALSE;
+		depthStencil.depthCompareOp = VK_COMPARE_OP_ALWAYS;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = shaderStages;
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pViewportState = &viewportState;
+		pipelineInfo.pRasterizationState = &rasterizer;
+		pipelineInfo.pMultisampleState = &multisampling;
+		pipelineInfo.pDepthStencilState = &depthStencil;
+		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.pDynamicState = &dynamicState;
+		pipelineInfo.layout = m_ParticlePipelineLayout;
+		pipelineInfo.renderPass = m_RenderPass;
+		pipelineInfo.subpass = 0;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineInfo.basePipelineIndex = -1;
+
+		VkPipeline pipeline{VK_NULL_HANDLE};
+		TRY_VK(m_PipelineCache.CreateGraphicsPipeline(pipelineInfo, pipeline))
+		return pipeline;
+	}
+
+	void createFramebuffers() {
+		m_SwapChainFramebuffers.resize(m_SwapChainImageViews.size());
+
+		for (int i = 0; i < m_SwapChainImageViews.size(); ++i) {
+			std::array<VkImageView, 3> attachments = {
+				m_ColorImageView, // Only possible due the way we built the semaphore beforehand.
+				m_DepthImageView, // Only possible due the way we built the semaphore beforehand.
+				m_SwapChainImageViews[i],
+			};
+
+			VkFramebufferCreateInfo framebufferInfo{};
+			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass = m_RenderPass;
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+			framebufferInfo.pAttachments = attachments.data();
+			framebufferInfo.width = m_SwapChainExtent.width;
+			framebufferInfo.height = m_SwapChainExtent.height;
+			framebufferInfo.layers = 1;
+
+			TRY_VK(vkCreateFramebuffer(m_Device, &framebufferInfo, nullptr, &m_SwapChainFramebuffers[i]));
+		}
+	}
+
+	void createCommandPool() {
+		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(m_PhysicalDevice);
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+		TRY_VK(vkCreateCommandPool(m_Device, &poolInfo, nullptr, &m_CommandPool));
+
+		// The compute command buffers are submitted to the compute queue, they need a pool of its family.
+		poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily.value();
+		TRY_VK(vkCreateCommandPool(m_Device, &poolInfo, nullptr, &m_ComputeCommandPool));
+	}
+
+	void createUploadBatcher() {
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+
+		// Uploads go through the transfer queue, the graphics queue acquires the resources.
+		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(m_PhysicalDevice);
+		const Imagine::Vulkan::UploadQueue transferQueue{m_TransferQueue, queueFamilyIndices.transferFamily.value()};
+		const Imagine::Vulkan::UploadQueue graphicsQueue{m_GraphicsQueue, queueFamilyIndices.graphicsFamily.value()};
+		m_Uploader.Init(m_Device, m_Allocator, transferQueue, graphicsQueue, Imagine::Vulkan::UploadBatcher::c_DefaultRingSize, properties.limits.optimalBufferCopyOffsetAlignment);
+	}
+
+	void createColorResources() {
+		VkFormat colorFormat = m_SwapChainImageFormat;
+		createImage(m_SwapChainExtent.width, m_SwapChainExtent.height, 1, m_MsaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_ColorImage, m_ColorImageMemory);
+		m_ColorImageView = createImageView(m_ColorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	}
+
+	void createDepthResources() {
+		VkFormat depthFormat = findDepthFormat();
+		createImage(m_SwapChainExtent.width, m_SwapChainExtent.height, 1, m_MsaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_DepthImage, m_DepthImageMemory);
+		m_DepthImageView = createImageView(m_DepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+
+		createDepthPyramid();
+
+		// Can be skipped as it will be done at the same time as the render pass. Just writting it here for completeness.
+		// transitionImageLayout(m_DepthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, 1);
+	}
+
+	void createDepthPyramid() {
+		// Power of two dimensions: every level halves the previous one exactly, which the culling relies on.
+		m_DepthPyramidExtent.width = previousPowerOfTwo(m_SwapChainExtent.width);
+		m_DepthPyramidExtent.height = previousPowerOfTwo(m_SwapChainExtent.height);
+		m_DepthPyramidMipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(m_DepthPyramidExtent.width, m_DepthPyramidExtent.height)))) + 1;
+
+		createImage(m_DepthPyramidExtent.width, m_DepthPyramidExtent.height, m_DepthPyramidMipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_DepthPyramidImage, m_DepthPyramidImageMemory);
+		m_DepthPyramidImageView = createImageView(m_DepthPyramidImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, m_DepthPyramidMipLevels);
+		m_DepthPyramidMipViews.resize(m_DepthPyramidMipLevels);
+		for (uint32_t level = 0; level < m_DepthPyramidMipLevels; ++level) {
+			m_DepthPyramidMipViews[level] = createImageView(m_DepthPyramidImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 1, level);
+		}
+
+		// One set per level, reading the previous level (or the depth attachment) and writing the level.
+		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[0].descriptorCount = m_DepthPyramidMipLevels;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		poolSizes[1].descriptorCount = m_DepthPyramidMipLevels;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = m_DepthPyramidMipLevels;
+		poolInfo.flags = 0;
+
+		TRY_VK(vkCreateDescriptorPool(m_Device, &poolInfo, nullptr, &m_DepthReduceDescriptorPool));
+
+		std::vector<VkDescriptorSetLayout> layouts(m_DepthPyramidMipLevels, m_DepthReduceDescriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = m_DepthReduceDescriptorPool;
+		allocInfo.descriptorSetCount = m_DepthPyramidMipLevels;
+		allocInfo.pSetLayouts = layouts.data();
+
+		m_DepthReduceDescriptorSets.resize(m_DepthPyramidMipLevels);
+		TRY_VK(vkAllocateDescriptorSets(m_Device, &allocInfo, m_DepthReduceDescriptorSets.data()));
+
+		for (uint32_t level = 0; level < m_DepthPyramidMipLevels; ++level) {
+			VkDescriptorImageInfo inputInfo{};
+			inputInfo.sampler = m_DepthPyramidSampler;
+			inputInfo.imageView = level == 0 ? m_DepthImageView : m_DepthPyramidMipViews[level - 1];
+			inputInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+			VkDescriptorImageInfo outputInfo{};
+			outputInfo.imageView = m_DepthPyramidMipViews[level];
+			outputInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+			std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[0].dstSet = m_DepthReduceDescriptorSets[level];
+			descriptorWrites[0].dstBinding = 0;
+			descriptorWrites[0].dstArrayElement = 0;
+			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			descriptorWrites[0].descriptorCount = 1;
+			descriptorWrites[0].pImageInfo = &inputInfo;
+
+			descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[1].dstSet = m_DepthReduceDescriptorSets[level];
+			descriptorWrites[1].dstBinding = 1;
+			descriptorWrites[1].dstArrayElement = 0;
+			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			descriptorWrites[1].descriptorCount = 1;
+			descriptorWrites[1].pImageInfo = &outputInfo;
+
+			vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		}
+	}
+
+	void createDepthPyramidSampler() {
+		// Only read with texelFetch, the filtering doesn't matter.
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.anisotropyEnable = VK_FALSE;
+		samplerInfo.maxAnisotropy = 1.0f;
+		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		samplerInfo.unnormalizedCoordinates = VK_FALSE;
+		samplerInfo.compareEnable = VK_FALSE;
+		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+		TRY_VK(vkCreateSampler(m_Device, &samplerInfo, nullptr, &m_DepthPyramidSampler));
+	}
+
+	// Every pipeline is independent from the others, each one is a job of the thread pool.
+	// They all share the pipeline cache, which the driver synchronizes.
+	void startPipelineCompilation() {
+		m_PipelineCompilationStart = std::chrono::steady_clock::now();
+		m_PipelineJobs.push_back(m_ThreadPool.Enqueue([this]() { createGraphicsPipeline(); }));
+		m_PipelineJobs.push_back(m_ThreadPool.Enqueue([this]() { createComputePipeline(); }));
+		m_PipelineJobs.push_back(m_ThreadPool.Enqueue([this]() { createParticlePipeline(); }));
+		m_PipelineJobs.push_back(m_ThreadPool.Enqueue([this]() { createCullingPipeline(); }));
+		m_PipelineJobs.push_back(m_ThreadPool.Enqueue([this]() { createDepthReducePipelines(); }));
+	}
+
+	// Every pipeline is used by the first frame: wait for all of them, rethrowing the first failure.
+	void waitForPipelines() {
+		const auto waitStart = std::chrono::steady_clock::now();
+		std::exception_ptr error{};
+		for (std::future<void>& job: m_PipelineJobs) {
+			try {
+				job.get();
+			} catch (...) {
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		}
+		m_PipelineJobs.clear();
+		if (error) {
+			std::rethrow_exception(error);
+		}
+		m_PipelineCache.EndStartup();
+
+		const auto now = std::chrono::steady_clock::now();
+		const auto flags = std::cout.flags();
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "[INFO] [PIPELINE] Pipelines ready " << std::chrono::duration<double, std::milli>(now - m_PipelineCompilationStart).count() << " ms after the start of their compilation on "
+				  << m_ThreadPool.GetThreadCount() << " threads, the startup waited " << std::chrono::duration<double, std::milli>(now - waitStart).count() << " ms for them." << std::endl;
+		std::cout.flags(flags);
+	}
+
+	void createDepthReduceDescriptorSetLayout() {
+		std::array<VkDescriptorSetLayoutBinding, 2> layoutBindings{};
+		layoutBindings[0].binding = 0;
+		layoutBindings[0].descriptorCount = 1;
+		layoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		layoutBindings[0].pImmutableSamplers = nullptr;
+		layoutBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		layoutBindings[1].binding = 1;
+		layoutBindings[1].descriptorCount = 1;
+		layoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		layoutBindings[1].pImmutableSamplers = nullptr;
+		layoutBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = layoutBindings.size();
+		layoutInfo.pBindings = layoutBindings.data();
+
+		TRY_VK(vkCreateDescriptorSetLayout(m_Device, &layoutInfo, nullptr, &m_DepthReduceDescriptorSetLayout));
+	}
+
+	void createDepthReducePipelines() {
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(DepthReducePushConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &m_DepthReduceDescriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		TRY_VK(vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, nullptr, &m_DepthReducePipelineLayout))
+
+		m_DepthReducePipeline = getPipeline(PipelineId::DepthReduce);
+		// A multisampled depth attachment is read through a sampler2DMS, for the first level only.
+		if (m_MsaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+			m_DepthReduceMultisampledPipeline = getPipeline(PipelineId::DepthReduceMultisampled);
+		}
+	}
+
+	VkPipeline createDepthReducePipeline(const std::span<const uint32_t> shaderCode) {
+		const ShaderModule shaderModule(m_Device, shaderCode);
+
+		VkPipelineShaderStageCreateInfo shaderStageInfo{};
+		shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderStageInfo.module = shaderModule.get();
+		shaderStageInfo.pName = "main";
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.layout = m_DepthReducePipelineLayout;
+		pipelineInfo.stage = shaderStageInfo;
+
+		VkPipeline pipeline{VK_NULL_HANDLE};
+		TRY_VK(m_PipelineCache.CreateComputePipeline(pipelineInfo, pipeline))
+		return pipeline;
+	}
+
+	// The reloaded SPIR-V once the shader changed, the one embedded by the build until then.
+	[[nodiscard]] std::span<const uint32_t> shaderCode(const ShaderId shader) const {
+		const std::vector<uint32_t>& reloaded = m_ReloadedShaders[static_cast<size_t>(shader)];
+		return reloaded.empty() ? SHADER_SOURCES[static_cast<size_t>(shader)].embedded : std::span<const uint32_t>(reloaded);
+	}
+
+	// The constant_id i of the shaders is the value i, see PipelineVariantCache.
+	[[nodiscard]] std::vector<uint32_t> specializationConstants(const PipelineId pipeline) const {
+		switch (pipeline) {
+			case PipelineId::Compute: return {m_ParticleWorkgroupSize};
+			case PipelineId::Culling: return {m_CullingWorkgroupSize, m_Parameters.occlusionCulling ? 1u : 0u};
+			default: return {};
+		}
+	}
+
+	// The variant matching the current specialization constants, built on the first request.
+	VkPipeline getPipeline(const PipelineId pipeline) {
+		return m_PipelineVariants.Get(static_cast<uint32_t>(pipeline), specializationConstants(pipeline), [this, pipeline](const VkSpecializationInfo* specialization) {
+			return buildPipeline(pipeline, specialization);
+		});
+	}
+
+	VkPipeline buildPipeline(const PipelineId pipeline, const VkSpecializationInfo* specialization) {
+		switch (pipeline) {
+			case PipelineId::Graphics: return buildGraphicsPipeline();
+			case PipelineId::Compute: return buildComputePipeline(specialization);
+			case PipelineId::Particle: return buildParticlePipeline();
+			case PipelineId::Culling: return buildCullingPipeline(specialization);
+			case PipelineId::DepthReduce: return createDepthReducePipeline(shaderCode(ShaderId::DepthReduceComp));
+			case PipelineId::DepthReduceMultisampled: return createDepthReducePipeline(shaderCode(ShaderId::DepthReduceMultisampledComp));
+		}
+		throw std::invalid_argument("unknown pipeline.");
+	}
+
+	VkPipeline& pipelineHandle(const PipelineId pipeline) {
+		switch (pipeline) {
+			case PipelineId::Graphics: return m_GraphicsPipeline;
+			case PipelineId::Compute: return m_ComputePipeline;
+			case PipelineId::Particle: return m_ParticlePipeline;
+			case PipelineId::Culling: return m_CullingPipeline;
+			case PipelineId::DepthReduce: return m_DepthReducePipeline;
+			case PipelineId::DepthReduceMultisampled: return m_DepthReduceMultisampledPipeline;
+		}
+		throw std::invalid_argument("unknown pipeline.");
+	}
+
+	void initShaderHotReload() {
+		if (!m_ShaderWatcher.Init(LVK_SHADER_SOURCE_DIR)) {
+			std::cerr << "[WARN] [SHADER] Can't watch " << LVK_SHADER_SOURCE_DIR << ", the shaders won't be reloaded." << std::endl;
+			return;
+		}
+		std::cout << "[INFO] [SHADER] Watching " << LVK_SHADER_SOURCE_DIR << " to reload the shaders." << std::endl;
+	}
+
+	// Called between two frames: the pipelines are only read when recording, on this thread.
+	void updateShaderHotReload() {
+		for (std::string& file: m_ShaderWatcher.Poll()) {
+			m_PendingShaderFiles.insert(std::move(file));
+		}
+
+		if (m_ShaderReload.valid() && m_ShaderReload.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			for (RebuiltPipeline& rebuilt: m_ShaderReload.get()) {
+				// Every variant was built from the previous shader, the frames in flight might still use one.
+				for (const VkPipeline variant: m_PipelineVariants.Evict(static_cast<uint32_t>(rebuilt.id))) {
+					m_RetiredPipelines.push_back({variant, m_SubmittedFrameCount});
+				}
+				m_PipelineVariants.Insert(static_cast<uint32_t>(rebuilt.id), rebuilt.constants, rebuilt.pipeline);
+				pipelineHandle(rebuilt.id) = rebuilt.pipeline;
+			}
+		}
+
+		// The last frame using a retired pipeline is complete once MAX_FRAMES_IN_FLIGHT more frames waited for its fences.
+		std::erase_if(m_RetiredPipelines, [this](const RetiredPipeline& retired) {
+			if (m_SubmittedFrameCount < retired.submittedFrameCount + MAX_FRAMES_IN_FLIGHT) {
+				return false;
+			}
+			vkDestroyPipeline(m_Device, retired.pipeline, nullptr);
+			return true;
+		});
+
+		// One reload at a time, m_ReloadedShaders is only written by the reload in progress.
+		if (!m_ShaderReload.valid() && !m_PendingShaderFiles.empty()) {
+			const std::string file = *m_PendingShaderFiles.begin();
+			m_PendingShaderFiles.erase(m_PendingShaderFiles.begin());
+			startShaderReload(file);
+		}
+	}
+
+	void startShaderReload(const std::string& file) {
+		std::vector<ShaderId> shaders;
+		std::vector<RebuiltPipeline> pipelines;
+		for (size_t i = 0; i < SHADER_SOURCES.size(); ++i) {
+			const ShaderSource& source = SHADER_SOURCES[i];
+			// The multisampled depth reduce only exists with MSAA.
+			if (file != source.file || pipelineHandle(source.pipeline) == VK_NULL_HANDLE) {
+				continue;
+			}
+			shaders.push_back(static_cast<ShaderId>(i));
+			if (std::none_of(pipelines.begin(), pipelines.end(), [&source](const RebuiltPipeline& pipeline) { return pipeline.id == source.pipeline; })) {
+				// Only the variant in use is rebuilt, the others will be on their next request.
+				pipelines.push_back({source.pipeline, specializationConstants(source.pipeline), VK_NULL_HANDLE});
+			}
+		}
+		if (shaders.empty()) {
+			return;
+		}
+
+		std::cout << "[INFO] [SHADER] " << file << " changed, recompiling it." << std::endl;
+		m_ShaderReload = m_ThreadPool.Enqueue([this, file, shaders = std::move(shaders), pipelines = std::move(pipelines)]() mutable {
+			return reloadShaders(file, shaders, std::move(pipelines));
+		});
+	}
+
+	// Runs on the thread pool. On failure nothing is returned, the current pipelines are kept.
+	std::vector<RebuiltPipeline> reloadShaders(const std::string& file, const std::vector<ShaderId>& shaders, std::vector<RebuiltPipeline> pipelines) {
+		const auto startTime = std::chrono::steady_clock::now();
+
+		// Restored if a pipeline fails to build, the next reload of another stage mustn't link against the broken code.
+		std::vector<std::vector<uint32_t>> previousCodes;
+		try {
+			std::vector<std::vector<uint32_t>> codes;
+			for (const ShaderId shader: shaders) {
+				codes.push_back(compileShader(SHADER_SOURCES[static_cast<size_t>(shader)]));
+				if (codes.back().empty()) {
+					std::cerr << "[WARN] [SHADER] " << file << " doesn't compile, keeping the current pipelines." << std::endl;
+					return {};
+				}
+			}
+			for (size_t i = 0; i < shaders.size(); ++i) {
+				previousCodes.push_back(std::exchange(m_ReloadedShaders[static_cast<size_t>(shaders[i])], std::move(codes[i])));
+			}
+
+			for (RebuiltPipeline& rebuilt: pipelines) {
+				rebuilt.pipeline = Imagine::Vulkan::PipelineVariantCache::Build(rebuilt.constants, [this, &rebuilt](const VkSpecializationInfo* specialization) {
+					return buildPipeline(rebuilt.id, specialization);
+				});
+			}
+		} catch (const std::exception& e) {
+			for (RebuiltPipeline& rebuilt: pipelines) {
+				vkDestroyPipeline(m_Device, rebuilt.pipeline, nullptr);
+				rebuilt.pipeline = VK_NULL_HANDLE;
+			}
+			for (size_t i = 0; i < previousCodes.size(); ++i) {
+				m_ReloadedShaders[static_cast<size_t>(shaders[i])] = std::move(previousCodes[i]);
+			}
+			std::cerr << "[WARN] [SHADER] Failed to reload " << file << ", keeping the current pipelines: " << e.what() << std::endl;
+			return {};
+		}
+
+		const auto flags = std::cout.flags();
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "[INFO] [SHADER] " << file << " reloaded in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count()
+				  << " ms, " << pipelines.size() << " pipelines rebuilt." << std::endl;
+		std::cout.flags(flags);
+		return pipelines;
+	}
+
+	// The device must be idle.
+	void shutdownShaderHotReload() {
+		if (m_ShaderReload.valid()) {
+			for (const RebuiltPipeline& rebuilt: m_ShaderReload.get()) {
+				vkDestroyPipeline(m_Device, rebuilt.pipeline, nullptr);
+			}
+		}
+		for (const RetiredPipeline& retired: m_RetiredPipelines) {
+			vkDestroyPipeline(m_Device, retired.pipeline, nullptr);
+		}
+		m_RetiredPipelines.clear();
+		m_ShaderWatcher.Shutdown();
+	}
+
+	void createTextureImage() {
+		Imagine::Core::Image<uint8_t> image;
+		{
+			int texWidth, texHeight, texChannels;
+			stbi_uc* pixels = stbi_load(TEXTURE_PATH, &texWidth, &texHeight, &texChannels, 4);
 
 			// The max function selects the largest dimension.
 			// The log2 function calculates how many times that dimension can be divided by 2.
@@ -807,33 +1936,28 @@ private:
 
 		TRY_MSG(image, "failed to load texture image!");
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-		void* data;
-		vkMapMemory(m_Device, stagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, image.Get(), static_cast<size_t>(imageSize));
-		vkUnmapMemory(m_Device, stagingBufferMemory);
-
-
-		// TODO: Combine everything in a single operation as to not allocate 4 Commands buffer and instead setup the correct barrier and run everything asynchronously as much as possible.
+		// Everything below is recorded in the current upload batch, nothing is executed until the batch is submitted.
 
 		// Allocating and parametrizing the vulkan image
 		createImage(static_cast<uint32_t>(image.GetWidth()), static_cast<uint32_t>(image.GetHeight()), m_MipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_TextureImage, m_TextureImageMemory);
 		// Changing the layout to be optimal to receive data from a buffer
 		transitionImageLayout(m_TextureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_MipLevels);
-		// Move the image Data from the buffer to the image
-		copyBufferToImage(stagingBuffer, m_TextureImage, static_cast<uint32_t>(image.GetWidth()), static_cast<uint32_t>(image.GetHeight()));
+		// Move the image Data through the staging ring to the image
+		m_Uploader.UploadImage(m_TextureImage, {static_cast<uint32_t>(image.GetWidth()), static_cast<uint32_t>(image.GetHeight()), 1}, VK_IMAGE_ASPECT_COLOR_BIT, image.Get(), imageSize);
+		// Blits need the graphics queue, hand the whole mip chain over before generating the mipmaps.
+		VkImageSubresourceRange textureRange{};
+		textureRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		textureRange.baseMipLevel = 0;
+		textureRange.levelCount = m_MipLevels;
+		textureRange.baseArrayLayer = 0;
+		textureRange.layerCount = 1;
+		m_Uploader.TransferImageOwnership(m_TextureImage, textureRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
 		// Rechange the layout of the image to be optimal to use while reading the image in the GPU.
 
 		// This transition no longer applies as it transfers the whole image, and we need to change the layout of each mipmap one by one while generating them.
 		//transitionImageLayout(m_TextureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_MipLevels);
 
 		generateMipmaps(m_TextureImage, VK_FORMAT_R8G8B8A8_SRGB, static_cast<int32_t>(image.GetWidth()), static_cast<int32_t>(image.GetHeight()), m_MipLevels);
-
-		vkDestroyBuffer(m_Device, stagingBuffer, nullptr);
-		vkFreeMemory(m_Device, stagingBufferMemory, nullptr);
 	}
 
 	void generateMipmaps(VkImage image, VkFormat imageFormat, const int32_t texWidth, const int32_t texHeight, const uint32_t mipLevels) {
@@ -846,7 +1970,8 @@ private:
 			//TODO: Special case of creating the mipmaps through a compute shader or on CPU.
 		}
 
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		// Recorded on the graphics queue, after the image was acquired from the transfer queue.
+		VkCommandBuffer commandBuffer = m_Uploader.GetOwnerCommandBuffer();
 
 		VkImageMemoryBarrier barrier{};
 		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -921,11 +2046,15 @@ private:
 			0, nullptr,
 			0, nullptr,
 			1, &barrier);
-		endSingleTimeCommands(commandBuffer);
 	}
 
 	void createTextureImageView() {
 		m_TextureImageView = createImageView(m_TextureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, m_MipLevels);
+		m_DefaultTextureIndex = m_TextureTable.Register(m_TextureImageView);
+	}
+
+	void createTextureTable() {
+		m_TextureTable.Init(m_PhysicalDevice, m_Device, m_TextureSampler);
 	}
 
 	void createTextureSampler() {
@@ -964,25 +2093,162 @@ private:
 		samplerInfo.mipLodBias = 0.0f; // Optional
 		samplerInfo.minLod = 0.0f; // Optional
 		// samplerInfo.minLod = static_cast<float>(m_MipLevels/2);
-		samplerInfo.maxLod = static_cast<float>(m_MipLevels);
+		// Shared by every texture of the bindless table, whatever their number of mip levels.
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
 		TRY_VK(vkCreateSampler(m_Device, &samplerInfo, nullptr, &m_TextureSampler));
 	}
 
 	bool loadModel() {
+		const auto startTime = std::chrono::steady_clock::now();
+
+		// Warm start: the cache holds the exact result of the import below.
+		const uint32_t processingFlags = m_Parameters.optimizeMeshes ? MESH_PROCESSING_OPTIMIZED : 0;
+		const Imagine::Core::MeshCacheKey cacheKey = Imagine::Core::MeshCacheKey::FromSource(MODEL_PATH, MODEL_IMPORT_FLAGS, sizeof(Vertex), processingFlags);
+		const std::filesystem::path cachePath = Imagine::Core::MeshCache::GetCachePath(MODEL_PATH);
+
+		// The geometry stays in the mapped cache, it's streamed from there into the staging ring by the upload.
+		const bool cacheHit = m_MeshCache.Open(cachePath, cacheKey);
+		if (!cacheHit) {
+			if (!importModel()) {
+				return false;
+			}
+			if (m_Parameters.optimizeMeshes) {
+				optimizeModel();
+			}
+			Imagine::Core::MeshCacheData cacheData{};
+			cacheData.vertices = m_Vertices.data();
+			cacheData.vertexCount = m_Vertices.size();
+			cacheData.indices = m_Indices.data();
+			cacheData.indexCount = m_Indices.size();
+			cacheData.meshes = m_Meshes.data();
+			cacheData.meshCount = m_Meshes.size();
+			cacheData.instances = m_Instances.data();
+			cacheData.instanceCount = m_Instances.size();
+
+			// Going through the new cache as well lets us drop the imported copy right away.
+			if (!Imagine::Core::MeshCache::Write(cachePath, cacheKey, cacheData)) {
+				std::cerr << "[WARN] [MESH] Failed to write the mesh cache " << cachePath << "." << std::endl;
+			} else if (m_MeshCache.Open(cachePath, cacheKey)) {
+				m_Vertices = {};
+				m_Indices = {};
+			}
+		}
+
+		m_VertexCount = m_MeshCache.IsOpen() ? static_cast<uint32_t>(m_MeshCache.GetVertexCount()) : static_cast<uint32_t>(m_Vertices.size());
+		m_IndexCount = m_MeshCache.IsOpen() ? static_cast<uint32_t>(m_MeshCache.GetIndexCount()) : static_cast<uint32_t>(m_Indices.size());
+		// The tables are tiny and outlive the geometry, they're kept in memory.
+		if (m_MeshCache.IsOpen()) {
+			m_Meshes.assign(m_MeshCache.GetMeshes(), m_MeshCache.GetMeshes() + m_MeshCache.GetMeshCount());
+			m_Instances.assign(m_MeshCache.GetInstances(), m_MeshCache.GetInstances() + m_MeshCache.GetInstanceCount());
+		}
+
+		const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+		std::cout << "[INFO] [MESH] Loaded " << m_Meshes.size() << " meshes (" << m_VertexCount << " vertices, " << m_IndexCount << " indices) in "
+				  << m_Instances.size() << " instances " << (cacheHit ? "from the cache" : "with Assimp") << " in " << milliseconds << " ms." << std::endl;
+		return true;
+	}
+
+	// Lay out copies of the scene on a grid around the origin, after the cache as they're only instances.
+	void replicateScene() {
+		const uint32_t copyCount = m_Parameters.sceneCopies;
+		if (copyCount <= 1 || m_Instances.empty()) {
+			return;
+		}
+
+		// The copies are spaced by the bounds of the whole scene.
+		glm::vec3 sceneMin{std::numeric_limits<float>::max()};
+		glm::vec3 sceneMax{std::numeric_limits<float>::lowest()};
+		for (const Imagine::Core::SceneInstance& instance: m_Instances) {
+			const Imagine::Core::SceneMesh& mesh = m_Meshes[instance.meshIndex];
+			for (uint32_t corner = 0; corner < 8; ++corner) {
+				const glm::vec3 position{(corner & 1) ? mesh.boundsMax.x : mesh.boundsMin.x, (corner & 2) ? mesh.boundsMax.y : mesh.boundsMin.y, (corner & 4) ? mesh.boundsMax.z : mesh.boundsMin.z};
+				const glm::vec3 transformed = glm::vec3(instance.transform * glm::vec4(position, 1.0f));
+				sceneMin = glm::min(sceneMin, transformed);
+				sceneMax = glm::max(sceneMax, transformed);
+			}
+		}
+		const glm::vec3 spacing = (sceneMax - sceneMin) * 1.25f;
+
+		const auto side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(copyCount))));
+		const std::vector<Imagine::Core::SceneInstance> scene = std::move(m_Instances);
+		m_Instances.clear();
+		m_Instances.reserve(scene.size() * copyCount);
+		for (uint32_t copy = 0; copy < copyCount; ++copy) {
+			// Z is up, the copies spread on the XY plane.
+			const glm::vec3 offset{(static_cast<float>(copy % side) - static_cast<float>(side - 1) * 0.5f) * spacing.x,
+								   (static_cast<float>(copy / side) - static_cast<float>(side - 1) * 0.5f) * spacing.y,
+								   0.0f};
+			const glm::mat4 translation = glm::translate(glm::mat4(1.0f), offset);
+			for (Imagine::Core::SceneInstance instance: scene) {
+				instance.transform = translation * instance.transform;
+				m_Instances.push_back(instance);
+			}
+		}
+
+		std::cout << "[INFO] [MESH] " << copyCount << " copies of the scene, " << m_Instances.size() << " instances." << std::endl;
+	}
+
+	// Reorder the imported geometry, the result is cached with the mesh.
+	void optimizeModel() {
+		using Imagine::Core::MeshOptimizer;
+		if (m_Vertices.empty()) {
+			return;
+		}
+		const auto startTime = std::chrono::steady_clock::now();
+		Imagine::Core::VertexCacheStatistics before{};
+		Imagine::Core::VertexCacheStatistics after{};
+
+		// Each mesh is optimized on its own, the vertex fetch pass shrinking the vertex ranges as it drops unused vertices.
+		std::vector<Vertex> vertices;
+		vertices.reserve(m_Vertices.size());
+		std::vector<uint32_t> indices;
+		indices.reserve(m_Indices.size());
+		for (Imagine::Core::SceneMesh& mesh: m_Meshes) {
+			std::vector<uint32_t> meshIndices(m_Indices.begin() + mesh.firstIndex, m_Indices.begin() + mesh.firstIndex + mesh.indexCount);
+			Vertex* meshVertices = m_Vertices.data() + mesh.firstVertex;
+			before += MeshOptimizer::AnalyzeVertexCache(meshIndices, mesh.vertexCount);
+
+			MeshOptimizer::OptimizeVertexCache(meshIndices, mesh.vertexCount);
+			MeshOptimizer::OptimizeOverdraw(meshIndices, &meshVertices[0].pos.x, mesh.vertexCount, sizeof(Vertex));
+			const size_t vertexCount = MeshOptimizer::OptimizeVertexFetch(meshIndices, meshVertices, mesh.vertexCount, sizeof(Vertex));
+			after += MeshOptimizer::AnalyzeVertexCache(meshIndices, vertexCount);
+
+			mesh.firstVertex = static_cast<uint32_t>(vertices.size());
+			mesh.vertexCount = static_cast<uint32_t>(vertexCount);
+			vertices.insert(vertices.end(), meshVertices, meshVertices + vertexCount);
+			mesh.firstIndex = static_cast<uint32_t>(indices.size());
+			indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+		}
+		m_Vertices = std::move(vertices);
+		m_Indices = std::move(indices);
+
+		const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+		const auto flags = std::cout.flags();
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << "[INFO] [MESH] Optimized " << after.triangleCount << " triangles in " << milliseconds << " ms"
+				  << " (FIFO " << MeshOptimizer::c_DefaultCacheSize << "): ACMR " << before.acmr << " -> " << after.acmr
+				  << ", ATVR " << before.atvr << " -> " << after.atvr << "." << std::endl;
+		std::cout.flags(flags);
+	}
+
+	// Once the upload is recorded the GPU buffers are the only copy we need.
+	void releaseModelData() {
+		m_MeshCache.Close();
+		// clear() would keep the capacity.
+		m_Vertices = {};
+		m_Indices = {};
+	}
+
+	bool importModel() {
 		// Create an instance of the Importer class
 		Assimp::Importer importer;
 
 		// And have it read the given file with some example postprocessing
 		// Usually - if speed is not the most important aspect for you - you'll
 		// probably to request more postprocessing than we do in this example.
-		const aiScene* scene = importer.ReadFile( MODEL_PATH,
-			aiProcess_Triangulate |
-			aiProcess_JoinIdenticalVertices |
-			aiProcess_GenUVCoords |
-			aiProcess_FlipUVs |
-			aiProcess_SortByPType
-			);
+		const aiScene* scene = importer.ReadFile(MODEL_PATH, MODEL_IMPORT_FLAGS);
 
 		// If the import failed, report it
 		if (nullptr == scene) {
@@ -992,178 +2258,633 @@ private:
 
 		// Now we can access the file's contents.
 
-		std::vector<const aiNode*> nodes{scene->mRootNode};
-
 		m_Vertices.clear();
-		m_Vertices.reserve(9000);
-
 		m_Indices.clear();
-		m_Indices.reserve(3000);
+		m_Meshes.clear();
+		m_Instances.clear();
+
+		// Every mesh once, in its own object space, whatever the number of nodes using it.
+		std::vector<uint32_t> sceneMeshIndices(scene->mNumMeshes, UINT32_MAX);
+		for (uint32_t meshIndex = 0; meshIndex < scene->mNumMeshes; ++meshIndex) {
+			const aiMesh& mesh = *scene->mMeshes[meshIndex];
+			if (mesh.mPrimitiveTypes != aiPrimitiveType_TRIANGLE) {
+				continue;
+			}
+			if (!mesh.HasPositions() || mesh.mNumVertices == 0) {
+				continue;
+			}
+
+			Imagine::Core::SceneMesh sceneMesh{};
+			sceneMesh.firstVertex = static_cast<uint32_t>(m_Vertices.size());
+			sceneMesh.vertexCount = mesh.mNumVertices;
+			sceneMesh.firstIndex = static_cast<uint32_t>(m_Indices.size());
+			sceneMesh.materialIndex = mesh.mMaterialIndex;
+			sceneMesh.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+			sceneMesh.boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+
+			for (uint32_t vertexIndex = 0u; vertexIndex < mesh.mNumVertices; ++vertexIndex) {
+				Vertex vertex{
+				{0,0,0},
+				{1,1,1},
+				{0,0},
+				};
+
+				const aiVector3D pos = mesh.mVertices[vertexIndex];
+				vertex.pos = {pos.x, pos.y, pos.z};
+				sceneMesh.boundsMin = glm::min(sceneMesh.boundsMin, vertex.pos);
+				sceneMesh.boundsMax = glm::max(sceneMesh.boundsMax, vertex.pos);
+
+				if (mesh.HasVertexColors(0)) {
+					aiColor4D texCoord = mesh.mColors[0][vertexIndex];
+					vertex.color = {texCoord.r, texCoord.g, texCoord.b};
+				}
+
+				if (mesh.HasTextureCoords(0)) {
+					aiVector3D texCoord = mesh.mTextureCoords[0][vertexIndex];
+					vertex.texCoord = {texCoord.x, texCoord.y};
+				}
+
+				m_Vertices.push_back(vertex);
+			}
 
-		// TODO: Optimize the loading by loading the vertices first and then adding only the indices for everytime I encounter those by storing the offset related to the mesh stored.
+			// Relative to the first vertex of the mesh.
+			for (uint32_t faceIndex = 0; faceIndex < mesh.mNumFaces; ++faceIndex) {
+				const aiFace& face = mesh.mFaces[faceIndex];
+				TRY(face.mNumIndices == 3);
+				m_Indices.push_back(face.mIndices[0]);
+				m_Indices.push_back(face.mIndices[1]);
+				m_Indices.push_back(face.mIndices[2]);
+			}
+			sceneMesh.indexCount = static_cast<uint32_t>(m_Indices.size()) - sceneMesh.firstIndex;
+
+			sceneMeshIndices[meshIndex] = static_cast<uint32_t>(m_Meshes.size());
+			m_Meshes.push_back(sceneMesh);
+		}
 
+		// One instance per mesh of each node, with the transforms of the whole hierarchy.
+		std::vector<std::pair<const aiNode*, aiMatrix4x4>> nodes{{scene->mRootNode, scene->mRootNode->mTransformation}};
 		while (!nodes.empty()) {
-			const aiNode& node = *nodes.back();
+			const auto [node, transform] = nodes.back();
 			nodes.pop_back();
 
-			const aiMatrix4x4 transform = node.mTransformation;
-			for (int meshIndex = 0; meshIndex < node.mNumMeshes; ++meshIndex) {
-				const aiMesh& mesh = *scene->mMeshes[node.mMeshes[meshIndex]];
-				if (mesh.mPrimitiveTypes != aiPrimitiveType_TRIANGLE) {
+			for (uint32_t i = 0; i < node->mNumMeshes; ++i) {
+				const uint32_t sceneMeshIndex = sceneMeshIndices[node->mMeshes[i]];
+				if (sceneMeshIndex == UINT32_MAX) {
 					continue;
 				}
-				if (!mesh.HasPositions()) {
-					continue;
+
+				Imagine::Core::SceneInstance instance{};
+				// Assimp matrices are row major, glm ones column major.
+				for (int row = 0; row < 4; ++row) {
+					for (int column = 0; column < 4; ++column) {
+						instance.transform[column][row] = transform[row][column];
+					}
 				}
-				const uint32_t offsetIndices = m_Vertices.size();
+				instance.meshIndex = sceneMeshIndex;
+				m_Instances.push_back(instance);
+			}
 
-				for (uint32_t vertexIndex = 0u; vertexIndex < mesh.mNumVertices; ++vertexIndex) {
-					Vertex vertex{
-					{0,0,0},
-					{1,1,1},
-					{0,0},
-					};
+			for (uint32_t i = 0; i < node->mNumChildren; ++i) {
+				nodes.emplace_back(node->mChildren[i], transform * node->mChildren[i]->mTransformation);
+			}
+		}
 
-					aiVector3D pos = transform * mesh.mVertices[vertexIndex];
-					vertex.pos = {pos.x, pos.y, pos.z};
+		// We're done. Everything will be cleaned up by the importer destructor
+		return true;
+	}
 
-					if (mesh.HasVertexColors(0)) {
-						aiColor4D texCoord = mesh.mColors[0][vertexIndex];
-						vertex.color = {texCoord.r, texCoord.g, texCoord.b};
-					}
+	[[nodiscard]] uint32_t getMaxWorkgroupSize() const {
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+		return std::min(properties.limits.maxComputeWorkGroupSize[0], properties.limits.maxComputeWorkGroupInvocations);
+	}
 
-					if (mesh.HasTextureCoords(0)) {
-						aiVector3D texCoord = mesh.mTextureCoords[0][vertexIndex];
-						vertex.texCoord = {texCoord.x, texCoord.y};
-					}
+	// Unlike the pipeline cache UUID, it doesn't change with the driver version.
+	[[nodiscard]] Imagine::Vulkan::DeviceUUID getDeviceUUID() const {
+		VkPhysicalDeviceIDProperties idProperties{};
+		idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &idProperties;
+		vkGetPhysicalDeviceProperties2(m_PhysicalDevice, &properties);
+
+		Imagine::Vulkan::DeviceUUID uuid{};
+		std::copy(std::begin(idProperties.deviceUUID), std::end(idProperties.deviceUUID), uuid.begin());
+		return uuid;
+	}
 
-					m_Vertices.push_back(vertex);
-				}
+	void checkWorkgroupSizes() {
+		const uint32_t maxWorkgroupSize = getMaxWorkgroupSize();
+		TRY_MSG(m_Parameters.particleWorkgroupSize <= maxWorkgroupSize, "the particle workgroup size exceeds the device limit (" + std::to_string(maxWorkgroupSize) + ").");
+		TRY_MSG(m_Parameters.cullingWorkgroupSize <= maxWorkgroupSize, "the culling workgroup size exceeds the device limit (" + std::to_string(maxWorkgroupSize) + ").");
+		m_CullingWorkgroupSize = m_Parameters.cullingWorkgroupSize;
+
+		m_ParticleWorkgroupSize = m_Parameters.particleWorkgroupSize;
+		if (m_ParticleWorkgroupSize == 0) {
+			Imagine::Vulkan::WorkgroupTuning tuning;
+			const uint32_t tunedSize = tuning.Load(WORKGROUP_TUNING_PATH) ? tuning.Find(getDeviceUUID(), m_Parameters.particleCount) : 0;
+			if (tunedSize > 0 && tunedSize <= maxWorkgroupSize) {
+				m_ParticleWorkgroupSize = tunedSize;
+				std::cout << "[INFO] [TUNING] Particle workgroup size of " << tunedSize << " tuned for this device." << std::endl;
+			} else {
+				m_ParticleWorkgroupSize = std::min(PARTICLE_WORKGROUP_SIZE, maxWorkgroupSize);
+			}
+		}
+	}
+
+	// One invocation per particle. Past the maximal group count on X, the groups wrap on Y.
+	[[nodiscard]] VkExtent2D getParticleDispatchSize(const uint32_t particleCount, const uint32_t workgroupSize) const {
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+		const uint32_t groupCount = (particleCount + workgroupSize - 1) / workgroupSize;
+		VkExtent2D dispatchSize{};
+		dispatchSize.width = std::min(groupCount, properties.limits.maxComputeWorkGroupCount[0]);
+		dispatchSize.height = (groupCount + dispatchSize.width - 1) / dispatchSize.width;
+		TRY_MSG(dispatchSize.height <= properties.limits.maxComputeWorkGroupCount[1], "too many particles for maxComputeWorkGroupCount.");
+		return dispatchSize;
+	}
+
+	void updateParticleDispatchSize() {
+		m_ParticleDispatchSize = getParticleDispatchSize(m_Parameters.particleCount, m_ParticleWorkgroupSize);
+	}
+
+	/**
+	 * Time the particle simulation with timestamp queries for every power of two workgroup size, at the particle count
+	 * and at a quarter and a sixteenth of it, then store the fastest size of each count for the device.
+	 * The particles aren't drawn, it works headless on any implementation with compute timestamps, lavapipe included.
+	 */
+	void tuneParticleWorkgroupSize() {
+		QueueFamilyIndices indices = findQueueFamilies(m_PhysicalDevice);
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(m_PhysicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(m_PhysicalDevice, &queueFamilyCount, queueFamilies.data());
+		const uint32_t timestampValidBits = queueFamilies[indices.computeFamily.value()].timestampValidBits;
+		TRY_MSG(timestampValidBits > 0, "the compute queue has no timestamp, the workgroup size can't be tuned.");
+
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+		std::cout << "[INFO] [TUNING] Tuning the particle workgroup size on " << properties.deviceName << "." << std::endl;
+
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2;
+		VkQueryPool queryPool{VK_NULL_HANDLE};
+		TRY_VK(vkCreateQueryPool(m_Device, &queryPoolInfo, nullptr, &queryPool));
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = m_ComputeCommandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		VkCommandBuffer commandBuffer{VK_NULL_HANDLE};
+		TRY_VK(vkAllocateCommandBuffers(m_Device, &allocInfo, &commandBuffer));
+
+		std::vector<uint32_t> particleCounts;
+		for (const uint32_t shift: {4u, 2u, 0u}) {
+			const uint32_t particleCount = m_Parameters.particleCount >> shift;
+			if (particleCount > 0 && (particleCounts.empty() || particleCounts.back() != particleCount)) {
+				particleCounts.push_back(particleCount);
+			}
+		}
 
-				for (int faceIndex = 0; faceIndex < mesh.mNumFaces; ++faceIndex) {
-					const aiFace& face = mesh.mFaces[faceIndex];
-					TRY(face.mNumIndices == 3);
-					m_Indices.push_back(offsetIndices + face.mIndices[0]);
-					m_Indices.push_back(offsetIndices + face.mIndices[1]);
-					m_Indices.push_back(offsetIndices + face.mIndices[2]);
+		const auto flags = std::cout.flags();
+		std::cout << std::fixed << std::setprecision(2);
+		std::vector<Imagine::Vulkan::WorkgroupTuningResult> results;
+		for (const uint32_t particleCount: particleCounts) {
+			Imagine::Vulkan::WorkgroupTuningResult best{particleCount, 0, std::numeric_limits<double>::max()};
+			for (uint32_t workgroupSize = TUNING_MIN_WORKGROUP_SIZE; workgroupSize <= getMaxWorkgroupSize(); workgroupSize *= 2) {
+				m_ParticleWorkgroupSize = workgroupSize;
+				const VkPipeline pipeline = getPipeline(PipelineId::Compute);
+
+				double microseconds = std::numeric_limits<double>::max();
+				for (uint32_t run = 0; run < TUNING_RUN_COUNT; ++run) {
+					microseconds = std::min(microseconds, timeParticleDispatch(commandBuffer, queryPool, pipeline, particleCount, timestampValidBits, properties.limits.timestampPeriod));
+				}
+				std::cout << "[INFO] [TUNING] " << particleCount << " particles, workgroups of " << workgroupSize << ": " << microseconds << " us per dispatch." << std::endl;
+				if (microseconds < best.dispatchMicroseconds) {
+					best.workgroupSize = workgroupSize;
+					best.dispatchMicroseconds = microseconds;
 				}
 			}
+			std::cout << "[INFO] [TUNING] Best for " << particleCount << " particles: workgroups of " << best.workgroupSize << " (" << best.dispatchMicroseconds << " us)." << std::endl;
+			results.push_back(best);
+		}
+		std::cout.flags(flags);
+
+		vkFreeCommandBuffers(m_Device, m_ComputeCommandPool, 1, &commandBuffer);
+		vkDestroyQueryPool(m_Device, queryPool, nullptr);
+
+		Imagine::Vulkan::WorkgroupTuning tuning;
+		tuning.Load(WORKGROUP_TUNING_PATH);
+		tuning.Set(getDeviceUUID(), std::move(results));
+		if (!tuning.Save(WORKGROUP_TUNING_PATH)) {
+			std::cerr << "[WARN] [TUNING] Failed to write " << WORKGROUP_TUNING_PATH << "." << std::endl;
+		} else {
+			std::cout << "[INFO] [TUNING] Saved in " << WORKGROUP_TUNING_PATH << ", used by the next runs on this device." << std::endl;
+		}
+	}
+
+	// The GPU time of one simulation step in microseconds, averaged over TUNING_DISPATCH_COUNT dispatches after a warm-up one.
+	double timeParticleDispatch(const VkCommandBuffer commandBuffer, const VkQueryPool queryPool, const VkPipeline pipeline, const uint32_t particleCount, const uint32_t timestampValidBits, const float timestampPeriod) {
+		// A null delta time, the particles don't move.
+		ComputeUniformBuffer ubo{};
+		ubo.deltaTime = 0.0f;
+		ubo.particleCount = particleCount;
+		memcpy(m_ComputeUniformBuffersMapped[0], &ubo, sizeof(ubo));
+		const VkExtent2D dispatchSize = getParticleDispatchSize(particleCount, m_ParticleWorkgroupSize);
+
+		TRY_VK(vkResetCommandBuffer(commandBuffer, 0));
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		TRY_VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
 
-			for (int i = 0; i < node.mNumChildren; ++i) {
-				nodes.push_back(node.mChildren[i]);
+		vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ComputePipelineLayout, 0, 1, &m_ComputeDescriptorSets[0], 0, nullptr);
+
+		// Serialized like the frames, each step waits for the previous one.
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		for (uint32_t dispatch = 0; dispatch <= TUNING_DISPATCH_COUNT; ++dispatch) {
+			// After the warm-up.
+			if (dispatch == 1) {
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, 0);
 			}
+			vkCmdDispatch(commandBuffer, dispatchSize.width, dispatchSize.height, 1);
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
 		}
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+		TRY_VK(vkEndCommandBuffer(commandBuffer));
 
-		// We're done. Everything will be cleaned up by the importer destructor
-		return true;
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		TRY_VK(vkQueueSubmit(m_ComputeQueue, 1, &submitInfo, VK_NULL_HANDLE));
+		TRY_VK(vkQueueWaitIdle(m_ComputeQueue));
+
+		std::array<uint64_t, 2> timestamps{};
+		TRY_VK(vkGetQueryPoolResults(m_Device, queryPool, 0, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+		// The counter wraps past its valid bits.
+		const uint64_t mask = timestampValidBits >= 64 ? std::numeric_limits<uint64_t>::max() : (uint64_t{1} << timestampValidBits) - 1;
+		const uint64_t ticks = (timestamps[1] - timestamps[0]) & mask;
+		// timestampPeriod is in nanoseconds per tick.
+		return static_cast<double>(ticks) * static_cast<double>(timestampPeriod) / 1000.0 / static_cast<double>(TUNING_DISPATCH_COUNT);
 	}
 
 	void createShaderStorageBuffers() {
 		m_ShaderStorageBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 		m_ShaderStorageBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
 
-		// Initialize particles
-		std::default_random_engine rndEngine((unsigned)time(nullptr));
-		std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
-
-		// Initial particle positions on a circle
-		std::vector<Particle> particles(PARTICLE_COUNT);
-		for (auto& particle : particles) {
-			float r = 0.25f * sqrt(rndDist(rndEngine));
-			float theta = rndDist(rndEngine) * 2 * 3.14159265358979323846;
-			float x = r * cos(theta) * HEIGHT / WIDTH;
-			float y = r * sin(theta);
-			particle.position = glm::vec2(x, y);
-			particle.velocity = glm::normalize(glm::vec2(x,y)) * 0.00025f;
-			particle.color = glm::vec4(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine), 1.0f);
-		}
-		VkDeviceSize bufferSize = sizeof(Particle) * PARTICLE_COUNT;
-
-		// Create the staging buffer.
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-		// Send memory to staged buffer.
-		void* data;
-		vkMapMemory(m_Device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, particles.data(), (size_t)bufferSize);
-		vkUnmapMemory(m_Device, stagingBufferMemory);
+		const VkDeviceSize bufferSize = getParticleBufferSize();
+
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+		TRY_MSG(bufferSize <= properties.limits.maxStorageBufferRange, "too many particles, the storage buffer exceeds maxStorageBufferRange (" + std::to_string(properties.limits.maxStorageBufferRange) + " bytes).");
+
+		updateParticleDispatchSize();
+
+		// The particles are generated straight into the staging ring, no intermediate copy.
+		const Imagine::Vulkan::StagingRegion staging = m_Uploader.Stage(bufferSize, alignof(Particle));
+		Particle* particles = static_cast<Particle*>(staging.mapped);
+
+		// Initial particle positions on a circle.
+		// Each particle draws its values from its own index, the result doesn't depend on how the work is split.
+		const Imagine::Core::CounterRandom random(static_cast<uint64_t>(time(nullptr)));
+		m_ThreadPool.ParallelFor(m_Parameters.particleCount, PARTICLE_INIT_GRAIN_SIZE, [particles, &random](const uint64_t begin, const uint64_t end) {
+			for (uint64_t particleIndex = begin; particleIndex < end; ++particleIndex) {
+				Particle& particle = particles[particleIndex];
+				float r = 0.25f * std::sqrt(random.NextFloat(particleIndex, 0));
+				float theta = random.NextFloat(particleIndex, 1) * 2.0f * 3.14159265358979323846f;
+				float x = r * std::cos(theta) * HEIGHT / WIDTH;
+				float y = r * std::sin(theta);
+				particle.position = glm::vec2(x, y);
+				// r may be 0, normalize would return NaN.
+				particle.velocity = r > 0.0f ? glm::normalize(glm::vec2(x, y)) * 0.00025f : glm::vec2(0.0f);
+				particle.color = glm::vec4(random.NextFloat(particleIndex, 2), random.NextFloat(particleIndex, 3), random.NextFloat(particleIndex, 4), 1.0f);
+			}
+		});
+
+		// Written by the compute queue, read as vertices by the graphics queue, initialized by the transfer queue:
+		// shared concurrently rather than transferring the ownership back and forth every frame.
+		const QueueFamilyIndices queueFamilyIndices = findQueueFamilies(m_PhysicalDevice);
+		const std::vector<uint32_t> queueFamilies = {queueFamilyIndices.graphicsFamily.value(), queueFamilyIndices.computeFamily.value(), queueFamilyIndices.transferFamily.value()};
 
 		// Copy memory into each fligh frame buffer.
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = staging.offset;
+		copyRegion.dstOffset = 0;
+		copyRegion.size = bufferSize;
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_ShaderStorageBuffers[i], m_ShaderStorageBuffersMemory[i]);
-			// Copy data from the staging buffer (host) to the shader storage buffer (GPU)
-			copyBuffer(stagingBuffer, m_ShaderStorageBuffers[i], bufferSize);
+			createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_ShaderStorageBuffers[i], m_ShaderStorageBuffersMemory[i], queueFamilies);
+			// Copy data from the staging ring (host) to the shader storage buffer (GPU)
+			// No ownership to transfer for concurrent buffers, the end of the upload batch makes the copy visible.
+			vkCmdCopyBuffer(m_Uploader.GetCommandBuffer(), staging.buffer, m_ShaderStorageBuffers[i], 1, &copyRegion);
 		}
 	}
 
+	[[nodiscard]] VkDeviceSize getParticleBufferSize() const {
+		return static_cast<VkDeviceSize>(sizeof(Particle)) * m_Parameters.particleCount;
+	}
+
 	void createVertexBuffer() {
-		/* It should be noted that in a real world application,
-		 * you're not supposed to actually call vkAllocateMemory for every individual buffer.
-		 * The maximum number of simultaneous memory allocations is limited by the maxMemoryAllocationCount physical device limit,
-		 * which may be as low as 4096 even on high end hardware like an NVIDIA GTX 1080.
-		 * The right way to allocate memory for a large number of objects at the same time is to create a custom allocator
-		 * that splits up a single allocation among many different objects by using the offset parameters that we've seen in many functions.
-		 * You can either implement such an allocator yourself, or use the [VulkanMemoryAllocator library](https://github.com/GPUOpen-LibrariesAndSDKs/VulkanMemoryAllocator) provided by the GPUOpen initiative.
-		 * However, for this tutorial, it's okay to use a separate allocation for every resource, because we won't come close to hitting any of these limits for now.
-		 */
-		const VkDeviceSize bufferSize = sizeof(Vertex) * m_Vertices.size();
+		const void* vertices = m_MeshCache.IsOpen() ? m_MeshCache.GetVertexData() : m_Vertices.data();
+		if (m_Parameters.vertexFormat == VertexFormat::Packed) {
+			createPackedVertexBuffer(static_cast<const Vertex*>(vertices));
+			return;
+		}
+
+		const VkDeviceSize bufferSize = sizeof(Vertex) * m_VertexCount;
+
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_VertexBuffer, m_VertexBufferMemory);
+
+		// Filling the staging ring with the vertices data and recording the copy to the device local buffer.
+		//  (VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ensure the data will be visible by vulkan when the batch is submitted).
+		// Read straight from the mapped cache, chunk by chunk, the pages are only faulted in when copied.
+		m_Uploader.UploadBuffer(m_VertexBuffer, 0, vertices, bufferSize);
+		m_Uploader.TransferBufferOwnership(m_VertexBuffer, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	}
+
+	// The mesh table entry of `mesh`, with the dequantization of its positions matching createPackedVertexBuffer.
+	[[nodiscard]] MeshData getMeshData(const Imagine::Core::SceneMesh& mesh) const {
+		MeshData meshData{};
+		meshData.boundsMin = glm::vec4(mesh.boundsMin, 0.0f);
+		meshData.boundsMax = glm::vec4(mesh.boundsMax, 0.0f);
+		if (m_Parameters.vertexFormat == VertexFormat::Packed) {
+			meshData.positionScale = glm::vec4(mesh.boundsMax - mesh.boundsMin, 0.0f);
+			meshData.positionOffset = glm::vec4(mesh.boundsMin, 0.0f);
+		} else {
+			meshData.positionScale = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+			meshData.positionOffset = glm::vec4(0.0f);
+		}
+		return meshData;
+	}
+
+	// Same as createVertexBuffer, packing the vertices while they're written in the staging memory.
+	// Each mesh is quantized against its own bounds, shader.vert reads them back from the mesh table.
+	void createPackedVertexBuffer(const Vertex* vertices) {
+		struct MeshQuantization {
+			uint32_t firstVertex;
+			glm::vec3 boundsMin;
+			glm::vec3 inverseExtent;
+		};
+		std::vector<MeshQuantization> quantizations;
+		quantizations.reserve(m_Meshes.size());
+		for (const Imagine::Core::SceneMesh& mesh: m_Meshes) {
+			const MeshData meshData = getMeshData(mesh);
+			MeshQuantization quantization{mesh.firstVertex, glm::vec3(meshData.positionOffset), glm::vec3(0.0f)};
+			// A flat axis keeps every vertex at the minimum instead of dividing by 0.
+			for (int axis = 0; axis < 3; ++axis) {
+				quantization.inverseExtent[axis] = meshData.positionScale[axis] > 0.0f ? 1.0f / meshData.positionScale[axis] : 0.0f;
+			}
+			quantizations.push_back(quantization);
+		}
+		std::sort(quantizations.begin(), quantizations.end(), [](const MeshQuantization& a, const MeshQuantization& b) { return a.firstVertex < b.firstVertex; });
+		if (quantizations.empty()) {
+			quantizations.push_back({0, glm::vec3(0.0f), glm::vec3(0.0f)});
+		}
+
+		const VkDeviceSize bufferSize = sizeof(PackedVertex) * m_VertexCount;
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_VertexBuffer, m_VertexBufferMemory);
+
+		// Chunks of a quarter of the ring, like UploadBuffer, so the GPU copies the previous chunks while we pack the next ones.
+		const uint64_t chunkVertexCount = std::max<uint64_t>(1, m_Uploader.GetRingSize() / 4 / sizeof(PackedVertex));
+		for (uint64_t first = 0; first < m_VertexCount; first += chunkVertexCount) {
+			const uint64_t count = std::min<uint64_t>(chunkVertexCount, m_VertexCount - first);
+			const Imagine::Vulkan::StagingRegion staging = m_Uploader.Stage(count * sizeof(PackedVertex), alignof(PackedVertex));
+			PackedVertex* packed = static_cast<PackedVertex*>(staging.mapped);
+
+			m_ThreadPool.ParallelFor(count, VERTEX_PACKING_GRAIN_SIZE, [packed, vertices, first, &quantizations](const uint64_t begin, const uint64_t end) {
+				// The mesh of the first vertex of the range, then the next ones as the range crosses them.
+				auto mesh = std::upper_bound(quantizations.begin() + 1, quantizations.end(), first + begin, [](const uint64_t vertex, const MeshQuantization& quantization) {
+					return vertex < quantization.firstVertex;
+				}) - 1;
+				for (uint64_t i = begin; i < end; ++i) {
+					while (mesh + 1 != quantizations.end() && (mesh + 1)->firstVertex <= first + i) {
+						++mesh;
+					}
+					packed[i] = PackedVertex::pack(vertices[first + i], mesh->boundsMin, mesh->inverseExtent);
+				}
+			});
+
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = staging.offset;
+			copyRegion.dstOffset = first * sizeof(PackedVertex);
+			copyRegion.size = count * sizeof(PackedVertex);
+			vkCmdCopyBuffer(m_Uploader.GetCommandBuffer(), staging.buffer, m_VertexBuffer, 1, &copyRegion);
+		}
+		m_Uploader.TransferBufferOwnership(m_VertexBuffer, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	}
+
+	void createIndexBuffer() {
+		const uint32_t* indices = m_MeshCache.IsOpen() ? m_MeshCache.GetIndices() : m_Indices.data();
+
+		// 16 bits indices wherever the vertices fit, the meshes being split in several draws if needed.
+		// Every mesh has its own ranges, one after the other in the buffer.
+		std::vector<std::vector<Imagine::Core::IndexRange>> meshRanges(m_Meshes.size());
+		std::vector<VkDeviceSize> meshByteOffsets(m_Meshes.size());
+		VkDeviceSize packedSize = 0;
+		for (size_t meshIndex = 0; meshIndex < m_Meshes.size(); ++meshIndex) {
+			const Imagine::Core::SceneMesh& mesh = m_Meshes[meshIndex];
+			meshRanges[meshIndex] = Imagine::Core::IndexPacking::Split(indices + mesh.firstIndex, mesh.indexCount);
+			meshByteOffsets[meshIndex] = packedSize;
+			packedSize += Imagine::Core::IndexPacking::GetPackedSize(meshRanges[meshIndex]);
+		}
+		const VkDeviceSize bufferSize = std::max<VkDeviceSize>(4, packedSize);
+
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_IndexBuffer, m_IndexBufferMemory);
+
+		// Every range of every mesh in buffer order: the packed ranges follow each other, only aligned on 4 bytes.
+		struct PackedSegment {
+			VkDeviceSize byteOffset;
+			const uint32_t* indices;
+			const Imagine::Core::IndexRange* range;
+		};
+		std::vector<PackedSegment> segments;
+
+		m_Draws.clear();
+		m_MeshDrawRanges.assign(m_Meshes.size(), {});
+		uint64_t indices16Count = 0;
+		for (size_t meshIndex = 0; meshIndex < m_Meshes.size(); ++meshIndex) {
+			const Imagine::Core::SceneMesh& mesh = m_Meshes[meshIndex];
+			const uint32_t* meshIndices = indices + mesh.firstIndex;
+			for (const Imagine::Core::IndexRange& range: meshRanges[meshIndex]) {
+				segments.push_back({meshByteOffsets[meshIndex] + range.byteOffset, meshIndices, &range});
+				meshIndices += range.indexCount;
+			}
+
+			m_MeshDrawRanges[meshIndex].firstDraw = static_cast<uint32_t>(m_Draws.size());
+			m_MeshDrawRanges[meshIndex].drawCount = static_cast<uint32_t>(meshRanges[meshIndex].size());
+			for (const Imagine::Core::IndexRange& range: meshRanges[meshIndex]) {
+				IndexedDraw draw{};
+				draw.indexType = range.indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+				draw.indexOffset = meshByteOffsets[meshIndex] + range.byteOffset;
+				draw.indexCount = range.indexCount;
+				draw.vertexOffset = static_cast<int32_t>(mesh.firstVertex) + range.vertexOffset;
+				m_Draws.push_back(draw);
+				indices16Count += range.indexSize == 2 ? range.indexCount : 0;
+			}
+		}
+
+		// Packed straight into the staging memory, in chunks of a quarter of the ring like the vertices,
+		// the GPU copies the previous chunks while we pack the next ones and the whole buffer is never staged at once.
+		// The chunks end on 4 bytes, so on an index of either size.
+		const VkDeviceSize chunkSize = std::max<VkDeviceSize>(4, m_Uploader.GetRingSize() / 4 / 4 * 4);
+		size_t segmentIndex = 0;
+		for (VkDeviceSize chunkStart = 0; chunkStart < packedSize; chunkStart += chunkSize) {
+			const VkDeviceSize chunkEnd = std::min<VkDeviceSize>(chunkStart + chunkSize, packedSize);
+			const Imagine::Vulkan::StagingRegion staging = m_Uploader.Stage(chunkEnd - chunkStart, 4);
+			auto* stagingBytes = static_cast<std::byte*>(staging.mapped);
+
+			// The part of each range falling in the chunk.
+			for (; segmentIndex < segments.size() && segments[segmentIndex].byteOffset < chunkEnd; ++segmentIndex) {
+				const PackedSegment& segment = segments[segmentIndex];
+				const uint32_t indexSize = segment.range->indexSize;
+				const uint32_t first = chunkStart > segment.byteOffset ? static_cast<uint32_t>((chunkStart - segment.byteOffset) / indexSize) : 0;
+				const uint32_t end = static_cast<uint32_t>(std::min<VkDeviceSize>(segment.range->indexCount, (chunkEnd - segment.byteOffset) / indexSize));
+				Imagine::Core::IndexPacking::PackRange(segment.indices, *segment.range, first, end - first, stagingBytes + (segment.byteOffset + first * indexSize - chunkStart));
+				// Continued in the next chunk.
+				if (end < segment.range->indexCount) {
+					break;
+				}
+			}
+
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = staging.offset;
+			copyRegion.dstOffset = chunkStart;
+			copyRegion.size = chunkEnd - chunkStart;
+			vkCmdCopyBuffer(m_Uploader.GetCommandBuffer(), staging.buffer, m_IndexBuffer, 1, &copyRegion);
+		}
+		m_Uploader.TransferBufferOwnership(m_IndexBuffer, VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+
+		std::cout << "[INFO] [MESH] " << m_Draws.size() << " draws, " << indices16Count << "/" << m_IndexCount << " indices on 16 bits, "
+				  << bufferSize << " bytes of indices instead of " << sizeof(uint32_t) * static_cast<uint64_t>(m_IndexCount) << "." << std::endl;
+	}
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
+	void createInstanceBuffer() {
+		std::vector<InstanceData> instances(m_Instances.size());
+		for (size_t i = 0; i < m_Instances.size(); ++i) {
+			instances[i].model = m_Instances[i].transform;
+		}
 
-		// Create the vertex buffer and its memory emplacement.
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		// Never empty, a descriptor can't reference a buffer of size 0.
+		const VkDeviceSize bufferSize = sizeof(InstanceData) * std::max<size_t>(1, instances.size());
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_InstanceBuffer, m_InstanceBufferMemory);
 
-		// Filling the memory with the vertices data
-		//  (VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ensure the data will be visible by vulkan instantly).
-		void* data{nullptr}; // some pointer
-		vkMapMemory(m_Device, stagingBufferMemory, 0, bufferSize, 0, &data); // Binding the variable to the CPU memory vulkan can read
-		memcpy(data, m_Vertices.data(), (size_t) bufferSize); // Copy the data for vulkan to use
-		vkUnmapMemory(m_Device, stagingBufferMemory); // Unmap the variable. Technically will map to nowhere.
-		data = nullptr; // Just my little security to avoid segfault.
+		m_Uploader.UploadBuffer(m_InstanceBuffer, 0, instances.data(), sizeof(InstanceData) * instances.size());
+		// Read by the culling pass as well.
+		m_Uploader.TransferBufferOwnership(m_InstanceBuffer, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	}
 
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_VertexBuffer, m_VertexBufferMemory);
+	void createMeshBuffer() {
+		// The bounds of each mesh for the culling pass, and the dequantization of its positions for shader.vert.
+		std::vector<MeshData> meshes;
+		meshes.reserve(m_Meshes.size());
+		for (const Imagine::Core::SceneMesh& mesh: m_Meshes) {
+			meshes.push_back(getMeshData(mesh));
+		}
 
-		copyBuffer(stagingBuffer, m_VertexBuffer, bufferSize);
+		const VkDeviceSize bufferSize = sizeof(MeshData) * std::max<size_t>(1, meshes.size());
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_MeshBuffer, m_MeshBufferMemory);
 
-		vkDestroyBuffer(m_Device, stagingBuffer, nullptr);
-		vkFreeMemory(m_Device, stagingBufferMemory, nullptr);
+		m_Uploader.UploadBuffer(m_MeshBuffer, 0, meshes.data(), sizeof(MeshData) * meshes.size());
+		m_Uploader.TransferBufferOwnership(m_MeshBuffer, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 	}
 
-	void createIndexBuffer() {
-		/* It should be noted that in a real world application,
-		 * you're not supposed to actually call vkAllocateMemory for every individual buffer.
-		 * The maximum number of simultaneous memory allocations is limited by the maxMemoryAllocationCount physical device limit,
-		 * which may be as low as 4096 even on high end hardware like an NVIDIA GTX 1080.
-		 * The right way to allocate memory for a large number of objects at the same time is to create a custom allocator
-		 * that splits up a single allocation among many different objects by using the offset parameters that we've seen in many functions.
-		 * You can either implement such an allocator yourself, or use the [VulkanMemoryAllocator library](https://github.com/GPUOpen-LibrariesAndSDKs/VulkanMemoryAllocator) provided by the GPUOpen initiative.
-		 * However, for this tutorial, it's okay to use a separate allocation for every resource, because we won't come close to hitting any of these limits for now.
-		 */
-		const VkDeviceSize bufferSize = sizeof(uint32_t) * m_Indices.size();
+	void createMaterialBuffer() {
+		uint32_t materialCount = 1;
+		for (const Imagine::Core::SceneMesh& mesh: m_Meshes) {
+			materialCount = std::max(materialCount, mesh.materialIndex + 1);
+		}
+
+		// The materials don't reference any texture of their own (the .mtl of the model isn't shipped), they all use the default one.
+		std::vector<MaterialData> materials(materialCount);
+		for (MaterialData& material: materials) {
+			material.textureIndex = m_DefaultTextureIndex;
+		}
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
+		const VkDeviceSize bufferSize = sizeof(MaterialData) * materials.size();
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_MaterialBuffer, m_MaterialBufferMemory);
 
-		// Create the vertex buffer and its memory emplacement.
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		m_Uploader.UploadBuffer(m_MaterialBuffer, 0, materials.data(), bufferSize);
+		m_Uploader.TransferBufferOwnership(m_MaterialBuffer, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+	}
 
-		// Filling the memory with the vertices data
-		//  (VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ensure the data will be visible by vulkan instantly).
-		void* data{nullptr}; // some pointer
-		vkMapMemory(m_Device, stagingBufferMemory, 0, bufferSize, 0, &data); // Binding the variable to the CPU memory vulkan can read
-		memcpy(data, m_Indices.data(), (size_t) bufferSize); // Copy the data for vulkan to use
-		vkUnmapMemory(m_Device, stagingBufferMemory); // Unmap the variable. Technically will map to nowhere.
-		data = nullptr; // Just my little security to avoid segfault.
+	void createDrawCommandBuffer() {
+		// One instanced command per index range of every mesh, grouped by index type so that a single bind serves a whole batch.
+		// firstIndex counts in indices of the batch type from offset 0, the ranges being aligned on 4 bytes.
+		std::vector<std::vector<uint32_t>> meshInstances(m_Meshes.size());
+		for (uint32_t instanceIndex = 0; instanceIndex < m_Instances.size(); ++instanceIndex) {
+			meshInstances[m_Instances[instanceIndex].meshIndex].push_back(instanceIndex);
+		}
 
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_IndexBuffer, m_IndexBufferMemory);
+		std::vector<VkDrawIndexedIndirectCommand> commands;
+		std::vector<DrawData> draws;
+		m_IndirectBatches.clear();
+		for (const VkIndexType indexType: {VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32}) {
+			const VkDeviceSize indexSize = indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+			IndirectBatch batch{};
+			batch.indexType = indexType;
+			batch.firstCommand = static_cast<uint32_t>(commands.size());
+
+			for (uint32_t meshIndex = 0; meshIndex < m_Meshes.size(); ++meshIndex) {
+				const MeshDrawRange& drawRange = m_MeshDrawRanges[meshIndex];
+				for (uint32_t drawIndex = drawRange.firstDraw; drawIndex < drawRange.firstDraw + drawRange.drawCount; ++drawIndex) {
+					const IndexedDraw& draw = m_Draws[drawIndex];
+					if (draw.indexType != indexType || meshInstances[meshIndex].empty()) {
+						continue;
+					}
 
-		copyBuffer(stagingBuffer, m_IndexBuffer, bufferSize);
+					// The culling pass counts the visible instances, their draw indices fill the slots from firstInstance.
+					VkDrawIndexedIndirectCommand command{};
+					command.indexCount = draw.indexCount;
+					command.instanceCount = 0;
+					command.firstIndex = static_cast<uint32_t>(draw.indexOffset / indexSize);
+					command.vertexOffset = draw.vertexOffset;
+					command.firstInstance = static_cast<uint32_t>(draws.size());
+					const uint32_t commandIndex = static_cast<uint32_t>(commands.size());
+					commands.push_back(command);
+
+					for (const uint32_t instanceIndex: meshInstances[meshIndex]) {
+						DrawData drawData{};
+						drawData.instanceIndex = instanceIndex;
+						drawData.meshIndex = meshIndex;
+						drawData.materialIndex = m_Meshes[meshIndex].materialIndex;
+						drawData.commandIndex = commandIndex;
+						draws.push_back(drawData);
+					}
+				}
+			}
 
-		vkDestroyBuffer(m_Device, stagingBuffer, nullptr);
-		vkFreeMemory(m_Device, stagingBufferMemory, nullptr);
+			batch.commandCount = static_cast<uint32_t>(commands.size()) - batch.firstCommand;
+			if (batch.commandCount > 0) {
+				m_IndirectBatches.push_back(batch);
+			}
+		}
+		m_CommandCount = static_cast<uint32_t>(commands.size());
+		m_DrawCount = static_cast<uint32_t>(draws.size());
+
+		// Never empty, a descriptor can't reference a buffer of size 0.
+		const VkDeviceSize commandBufferSize = sizeof(VkDrawIndexedIndirectCommand) * std::max<size_t>(1, commands.size());
+		// The commands without any instance, copied into the buffer actually drawn before each culling pass.
+		createBuffer(commandBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_DrawCommandBuffer, m_DrawCommandBufferMemory);
+		m_Uploader.UploadBuffer(m_DrawCommandBuffer, 0, commands.data(), sizeof(VkDrawIndexedIndirectCommand) * commands.size());
+		m_Uploader.TransferBufferOwnership(m_DrawCommandBuffer, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		const VkDeviceSize drawDataBufferSize = sizeof(DrawData) * std::max<size_t>(1, draws.size());
+		createBuffer(drawDataBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_DrawDataBuffer, m_DrawDataBufferMemory);
+		m_Uploader.UploadBuffer(m_DrawDataBuffer, 0, draws.data(), sizeof(DrawData) * draws.size());
+		m_Uploader.TransferBufferOwnership(m_DrawDataBuffer, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		std::cout << "[INFO] [MESH] " << m_DrawCount << " draws in " << m_CommandCount << " instanced indirect commands, " << m_IndirectBatches.size() << " batches"
+				  << (m_MultiDrawIndirect ? "." : ", one call per command as multiDrawIndirect isn't supported.") << std::endl;
 	}
 
 	void createUniformBuffers() {
@@ -1176,7 +2897,7 @@ private:
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 			createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_UniformBuffers[i], m_UniformBuffersMemory[i]);
 
-			vkMapMemory(m_Device, m_UniformBuffersMemory[i], 0, bufferSize, 0, &m_UniformBuffersMapped[i]);
+			m_UniformBuffersMapped[i] = m_UniformBuffersMemory[i].mapped;
 		}
 	}
 
@@ -1190,16 +2911,18 @@ private:
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 			createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_ComputeUniformBuffers[i], m_ComputeUniformBuffersMemory[i]);
 
-			vkMapMemory(m_Device, m_ComputeUniformBuffersMemory[i], 0, bufferSize, 0, &m_ComputeUniformBuffersMapped[i]);
+			m_ComputeUniformBuffersMapped[i] = m_ComputeUniformBuffersMemory[i].mapped;
 		}
 	}
 
 	void createDescriptorPool() {
-		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		std::array<VkDescriptorPoolSize, 3> poolSizes{};
 		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 		poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+		poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 4;
 
 		VkDescriptorPoolCreateInfo poolInfo{};
 		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -1228,13 +2951,32 @@ private:
 			bufferInfo.offset = 0;
 			bufferInfo.range = sizeof(UniformBufferObject);
 
-			// Assign the image into the descriptor set.
-			VkDescriptorImageInfo imageInfo{};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = m_TextureImageView;
-			imageInfo.sampler = m_TextureSampler;
+			VkDescriptorBufferInfo materialBufferInfo{};
+			materialBufferInfo.buffer = m_MaterialBuffer;
+			materialBufferInfo.offset = 0;
+			materialBufferInfo.range = VK_WHOLE_SIZE;
 
-			std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+			VkDescriptorBufferInfo instanceBufferInfo{};
+			instanceBufferInfo.buffer = m_InstanceBuffer;
+			instanceBufferInfo.offset = 0;
+			instanceBufferInfo.range = VK_WHOLE_SIZE;
+
+			VkDescriptorBufferInfo drawDataBufferInfo{};
+			drawDataBufferInfo.buffer = m_DrawDataBuffer;
+			drawDataBufferInfo.offset = 0;
+			drawDataBufferInfo.range = VK_WHOLE_SIZE;
+
+			VkDescriptorBufferInfo visibleDrawBufferInfo{};
+			visibleDrawBufferInfo.buffer = m_VisibleDrawBuffers[i];
+			visibleDrawBufferInfo.offset = 0;
+			visibleDrawBufferInfo.range = VK_WHOLE_SIZE;
+
+			VkDescriptorBufferInfo meshBufferInfo{};
+			meshBufferInfo.buffer = m_MeshBuffer;
+			meshBufferInfo.offset = 0;
+			meshBufferInfo.range = VK_WHOLE_SIZE;
+
+			std::array<VkWriteDescriptorSet, 6> descriptorWrites{};
 			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 			descriptorWrites[0].dstSet = m_DescriptorSets[i];
 			descriptorWrites[0].dstBinding = 0;
@@ -1250,12 +2992,41 @@ private:
 			descriptorWrites[1].dstSet = m_DescriptorSets[i];
 			descriptorWrites[1].dstBinding = 1;
 			descriptorWrites[1].dstArrayElement = 0;
-			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 			descriptorWrites[1].descriptorCount = 1;
-			// One of the three need to be set.
-			descriptorWrites[1].pBufferInfo = nullptr; // Optional
-			descriptorWrites[1].pImageInfo = &imageInfo; // Optional
-			descriptorWrites[1].pTexelBufferView = nullptr; // Optional
+			descriptorWrites[1].pBufferInfo = &materialBufferInfo;
+
+			descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[2].dstSet = m_DescriptorSets[i];
+			descriptorWrites[2].dstBinding = 2;
+			descriptorWrites[2].dstArrayElement = 0;
+			descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[2].descriptorCount = 1;
+			descriptorWrites[2].pBufferInfo = &instanceBufferInfo;
+
+			descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[3].dstSet = m_DescriptorSets[i];
+			descriptorWrites[3].dstBinding = 3;
+			descriptorWrites[3].dstArrayElement = 0;
+			descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[3].descriptorCount = 1;
+			descriptorWrites[3].pBufferInfo = &drawDataBufferInfo;
+
+			descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[4].dstSet = m_DescriptorSets[i];
+			descriptorWrites[4].dstBinding = 4;
+			descriptorWrites[4].dstArrayElement = 0;
+			descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[4].descriptorCount = 1;
+			descriptorWrites[4].pBufferInfo = &visibleDrawBufferInfo;
+
+			descriptorWrites[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[5].dstSet = m_DescriptorSets[i];
+			descriptorWrites[5].dstBinding = 5;
+			descriptorWrites[5].dstArrayElement = 0;
+			descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[5].descriptorCount = 1;
+			descriptorWrites[5].pBufferInfo = &meshBufferInfo;
 
 			vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 		}
@@ -1325,14 +3096,14 @@ private:
 			uniformBufferInfo.range = sizeof(ComputeUniformBuffer);
 
 			VkDescriptorBufferInfo storageBufferInfoLastFrame{};
-			storageBufferInfoLastFrame.buffer = m_ShaderStorageBuffers[(i - 1) % MAX_FRAMES_IN_FLIGHT];
+			storageBufferInfoLastFrame.buffer = m_ShaderStorageBuffers[(i + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT];
 			storageBufferInfoLastFrame.offset = 0;
-			storageBufferInfoLastFrame.range = sizeof(Particle) * PARTICLE_COUNT;
+			storageBufferInfoLastFrame.range = getParticleBufferSize();
 
 			VkDescriptorBufferInfo storageBufferInfoCurrentFrame{};
 			storageBufferInfoCurrentFrame.buffer = m_ShaderStorageBuffers[i];
 			storageBufferInfoCurrentFrame.offset = 0;
-			storageBufferInfoCurrentFrame.range = sizeof(Particle) * PARTICLE_COUNT;
+			storageBufferInfoCurrentFrame.range = getParticleBufferSize();
 
 			std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
 			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1366,6 +3137,158 @@ private:
 		}
 	}
 
+	void createCullingBuffers() {
+		const VkDeviceSize commandBufferSize = sizeof(VkDrawIndexedIndirectCommand) * std::max<uint32_t>(1, m_CommandCount);
+		const VkDeviceSize visibleDrawBufferSize = sizeof(uint32_t) * std::max<uint32_t>(1, m_DrawCount);
+		// Number of visible draws, for the statistics.
+		const VkDeviceSize drawCountBufferSize = sizeof(uint32_t);
+		// The counts of both phases.
+		const VkDeviceSize readbackBufferSize = drawCountBufferSize * 2;
+
+		m_CullingUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+		m_CullingUniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+		m_CulledCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+		m_CulledCommandBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+		m_VisibleDrawBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+		m_VisibleDrawBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+		m_DrawCountBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+		m_DrawCountBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+		m_DrawCountReadbackBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+		m_DrawCountReadbackBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+		m_CullingStatisticsPending.assign(MAX_FRAMES_IN_FLIGHT, false);
+
+		// Each frame in flight culls in its own buffers, the previous frame might still be drawing from its own.
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			createBuffer(sizeof(CullingUniformBuffer), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_CullingUniformBuffers[i], m_CullingUniformBuffersMemory[i]);
+			createBuffer(commandBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_CulledCommandBuffers[i], m_CulledCommandBuffersMemory[i]);
+			createBuffer(visibleDrawBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_VisibleDrawBuffers[i], m_VisibleDrawBuffersMemory[i]);
+			createBuffer(drawCountBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_DrawCountBuffers[i], m_DrawCountBuffersMemory[i]);
+			createBuffer(readbackBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_DrawCountReadbackBuffers[i], m_DrawCountReadbackBuffersMemory[i]);
+		}
+
+		// Written by the late phase of a frame, read by the early phase of the next one: a single buffer for every frame.
+		createBuffer(sizeof(uint32_t) * std::max<uint32_t>(1, m_DrawCount), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_VisibilityBuffer, m_VisibilityBufferMemory);
+		m_VisibilityBufferCleared = false;
+	}
+
+	void createCullingDescriptorPool() {
+		std::array<VkDescriptorPoolSize, 3> poolSizes{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 7;
+		poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+		poolInfo.flags = 0;
+
+		TRY_VK(vkCreateDescriptorPool(m_Device, &poolInfo, nullptr, &m_CullingDescriptorPool));
+	}
+
+	void createCullingDescriptorSetLayout() {
+		// Binding 0 is the uniform buffer, 7 the depth pyramid, the others are the storage buffers of cull.comp.
+		std::array<VkDescriptorSetLayoutBinding, 9> layoutBindings{};
+		for (uint32_t binding = 0; binding < layoutBindings.size(); ++binding) {
+			layoutBindings[binding].binding = binding;
+			layoutBindings[binding].descriptorCount = 1;
+			layoutBindings[binding].descriptorType = getCullingDescriptorType(binding);
+			layoutBindings[binding].pImmutableSamplers = nullptr;
+			layoutBindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = layoutBindings.size();
+		layoutInfo.pBindings = layoutBindings.data();
+
+		TRY_VK(vkCreateDescriptorSetLayout(m_Device, &layoutInfo, nullptr, &m_CullingDescriptorSetLayout));
+	}
+
+	[[nodiscard]] static VkDescriptorType getCullingDescriptorType(const uint32_t binding) {
+		switch (binding) {
+			case 0: return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			case 7: return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			default: return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		}
+	}
+
+	void createCullingDescriptorSets() {
+		std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, m_CullingDescriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = m_CullingDescriptorPool;
+		allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+		allocInfo.pSetLayouts = layouts.data();
+
+		m_CullingDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+		TRY_VK(vkAllocateDescriptorSets(m_Device, &allocInfo, m_CullingDescriptorSets.data()));
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			// Same order as the bindings of cull.comp, the depth pyramid (7) being written on its own.
+			const std::array<VkBuffer, 9> buffers = {
+				m_CullingUniformBuffers[i],
+				m_VisibleDrawBuffers[i],
+				m_DrawDataBuffer,
+				m_MeshBuffer,
+				m_InstanceBuffer,
+				m_CulledCommandBuffers[i],
+				m_DrawCountBuffers[i],
+				VK_NULL_HANDLE,
+				m_VisibilityBuffer,
+			};
+
+			std::array<VkDescriptorBufferInfo, 9> bufferInfos{};
+			std::vector<VkWriteDescriptorSet> descriptorWrites{};
+			for (uint32_t binding = 0; binding < buffers.size(); ++binding) {
+				if (buffers[binding] == VK_NULL_HANDLE) {
+					continue;
+				}
+				bufferInfos[binding].buffer = buffers[binding];
+				bufferInfos[binding].offset = 0;
+				bufferInfos[binding].range = VK_WHOLE_SIZE;
+
+				VkWriteDescriptorSet& descriptorWrite = descriptorWrites.emplace_back();
+				descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				descriptorWrite.dstSet = m_CullingDescriptorSets[i];
+				descriptorWrite.dstBinding = binding;
+				descriptorWrite.dstArrayElement = 0;
+				descriptorWrite.descriptorType = getCullingDescriptorType(binding);
+				descriptorWrite.descriptorCount = 1;
+				descriptorWrite.pBufferInfo = &bufferInfos[binding];
+			}
+
+			vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		}
+
+		writeCullingDepthPyramidDescriptors();
+	}
+
+	// The depth pyramid is recreated with the swap chain.
+	void writeCullingDepthPyramidDescriptors() {
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.sampler = m_DepthPyramidSampler;
+		imageInfo.imageView = m_DepthPyramidImageView;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		for (size_t i = 0; i < m_CullingDescriptorSets.size(); i++) {
+			VkWriteDescriptorSet descriptorWrite{};
+			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrite.dstSet = m_CullingDescriptorSets[i];
+			descriptorWrite.dstBinding = 7;
+			descriptorWrite.dstArrayElement = 0;
+			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			descriptorWrite.descriptorCount = 1;
+			descriptorWrite.pImageInfo = &imageInfo;
+
+			vkUpdateDescriptorSets(m_Device, 1, &descriptorWrite, 0, nullptr);
+		}
+	}
+
 	void createCommandBuffers() {
 		m_CommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 
@@ -1376,6 +3299,12 @@ private:
 		allocInfo.commandBufferCount = m_CommandBuffers.size();
 
 		TRY_VK(vkAllocateCommandBuffers(m_Device, &allocInfo, m_CommandBuffers.data()));
+
+		m_ComputeCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+		allocInfo.commandPool = m_ComputeCommandPool;
+		allocInfo.commandBufferCount = m_ComputeCommandBuffers.size();
+
+		TRY_VK(vkAllocateCommandBuffers(m_Device, &allocInfo, m_ComputeCommandBuffers.data()));
 	}
 
 	void createSyncObjects() {
@@ -1392,59 +3321,170 @@ private:
 		imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 		renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 		inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+		m_ComputeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+		m_ComputeInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
 
 		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
 			TRY_VK(vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]));
 			TRY_VK(vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]));
 			TRY_VK(vkCreateFence(m_Device, &fenceInfo, nullptr, &inFlightFences[i]));
+			TRY_VK(vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_ComputeFinishedSemaphores[i]));
+			TRY_VK(vkCreateFence(m_Device, &fenceInfo, nullptr, &m_ComputeInFlightFences[i]));
 		}
 	}
 
 	void mainLoop() {
-		while (!glfwWindowShouldClose(m_Window)) {
-			glfwPollEvents();
+		const auto startTime = std::chrono::steady_clock::now();
+		uint64_t frameCount = 0;
+
+		while (shouldKeepRendering(frameCount)) {
+			if (!m_Parameters.headless) {
+				glfwPollEvents();
+			}
+			if (m_Parameters.hotReloadShaders) {
+				updateShaderHotReload();
+			}
 			drawFrame();
+			++frameCount;
 		}
 
 		vkDeviceWaitIdle(m_Device);
+
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		if (frameCount > 0 && seconds > 0.0) {
+			std::cout << "[INFO] Rendered " << frameCount << " frames in " << seconds << "s ("
+					  << static_cast<double>(frameCount) / seconds << " FPS, "
+					  << seconds * 1000.0 / static_cast<double>(frameCount) << " ms/frame)." << std::endl;
+		}
+		logCullingStatistics();
+	}
+
+	void logCullingStatistics() {
+		// The frames still in flight at the end are never read back.
+		for (uint16_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame) {
+			readCullingStatistics(frame);
+		}
+
+		const CullingStatistics& statistics = m_CullingStatistics;
+		if (statistics.frameCount == 0 || statistics.totalDrawCount == 0) {
+			return;
+		}
+		std::cout << "[INFO] [CULLING] " << statistics.lastVisibleDrawCount << "/" << m_DrawCount << " draws visible on the last frame ("
+				  << statistics.lastLateDrawCount << " found by the late phase), "
+				  << std::fixed << std::setprecision(1) << 100.0 * static_cast<double>(statistics.visibleDrawCount) / static_cast<double>(statistics.totalDrawCount)
+				  << "% on average over " << statistics.frameCount << " frames." << std::defaultfloat << std::endl;
+	}
+
+	[[nodiscard]] bool shouldKeepRendering(const uint64_t frameCount) const {
+		if (m_Parameters.frameCount > 0 && frameCount >= m_Parameters.frameCount) {
+			return false;
+		}
+		return m_Parameters.headless || !glfwWindowShouldClose(m_Window);
 	}
 
 	void cleanup() {
+		shutdownShaderHotReload();
 		cleanupSwapChain();
 
+		m_TextureTable.Shutdown();
 		vkDestroySampler(m_Device, m_TextureSampler, nullptr);
     	vkDestroyImageView(m_Device, m_TextureImageView, nullptr);
 		vkDestroyImage(m_Device, m_TextureImage, nullptr);
-		vkFreeMemory(m_Device, m_TextureImageMemory, nullptr);
+		m_Allocator.Free(m_TextureImageMemory);
 
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 			vkDestroyBuffer(m_Device, m_UniformBuffers[i], nullptr);
-			vkFreeMemory(m_Device, m_UniformBuffersMemory[i], nullptr);
+			m_Allocator.Free(m_UniformBuffersMemory[i]);
 			m_UniformBuffersMapped[i] = nullptr;
 		}
 		vkDestroyDescriptorPool(m_Device, m_DescriptorPool, nullptr);
 		vkDestroyDescriptorSetLayout(m_Device, m_DescriptorSetLayout, nullptr);
 
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			vkDestroyBuffer(m_Device, m_ComputeUniformBuffers[i], nullptr);
+			m_Allocator.Free(m_ComputeUniformBuffersMemory[i]);
+			m_ComputeUniformBuffersMapped[i] = nullptr;
+
+			vkDestroyBuffer(m_Device, m_ShaderStorageBuffers[i], nullptr);
+			m_Allocator.Free(m_ShaderStorageBuffersMemory[i]);
+		}
+		vkDestroyDescriptorPool(m_Device, m_ComputeDescriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(m_Device, m_ComputeDescriptorSetLayout, nullptr);
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			vkDestroyBuffer(m_Device, m_CullingUniformBuffers[i], nullptr);
+			m_Allocator.Free(m_CullingUniformBuffersMemory[i]);
+			vkDestroyBuffer(m_Device, m_CulledCommandBuffers[i], nullptr);
+			m_Allocator.Free(m_CulledCommandBuffersMemory[i]);
+			vkDestroyBuffer(m_Device, m_VisibleDrawBuffers[i], nullptr);
+			m_Allocator.Free(m_VisibleDrawBuffersMemory[i]);
+			vkDestroyBuffer(m_Device, m_DrawCountBuffers[i], nullptr);
+			m_Allocator.Free(m_DrawCountBuffersMemory[i]);
+			vkDestroyBuffer(m_Device, m_DrawCountReadbackBuffers[i], nullptr);
+			m_Allocator.Free(m_DrawCountReadbackBuffersMemory[i]);
+		}
+		vkDestroyBuffer(m_Device, m_VisibilityBuffer, nullptr);
+		m_Allocator.Free(m_VisibilityBufferMemory);
+		vkDestroyDescriptorPool(m_Device, m_CullingDescriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(m_Device, m_CullingDescriptorSetLayout, nullptr);
+
 		vkDestroyBuffer(m_Device, m_IndexBuffer, nullptr);
-		vkFreeMemory(m_Device, m_IndexBufferMemory, nullptr);
+		m_Allocator.Free(m_IndexBufferMemory);
+
+		vkDestroyBuffer(m_Device, m_InstanceBuffer, nullptr);
+		m_Allocator.Free(m_InstanceBufferMemory);
+
+		vkDestroyBuffer(m_Device, m_DrawCommandBuffer, nullptr);
+		m_Allocator.Free(m_DrawCommandBufferMemory);
+
+		vkDestroyBuffer(m_Device, m_DrawDataBuffer, nullptr);
+		m_Allocator.Free(m_DrawDataBufferMemory);
+
+		vkDestroyBuffer(m_Device, m_MeshBuffer, nullptr);
+		m_Allocator.Free(m_MeshBufferMemory);
+		vkDestroyBuffer(m_Device, m_MaterialBuffer, nullptr);
+		m_Allocator.Free(m_MaterialBufferMemory);
 
 		vkDestroyBuffer(m_Device, m_VertexBuffer, nullptr);
-		vkFreeMemory(m_Device, m_VertexBufferMemory, nullptr); // Free memory after the object occupying is freed.
+		m_Allocator.Free(m_VertexBufferMemory); // Free memory after the object occupying is freed.
+
+		// Owns every pipeline.
+		m_PipelineVariants.Shutdown();
 
-		vkDestroyPipeline(m_Device, m_GraphicsPipeline, nullptr);
 		vkDestroyPipelineLayout(m_Device, m_PipelineLayout, nullptr);
+		vkDestroyPipelineLayout(m_Device, m_ComputePipelineLayout, nullptr);
+		vkDestroyPipelineLayout(m_Device, m_CullingPipelineLayout, nullptr);
+
+		vkDestroyPipelineLayout(m_Device, m_DepthReducePipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(m_Device, m_DepthReduceDescriptorSetLayout, nullptr);
+		vkDestroySampler(m_Device, m_DepthPyramidSampler, nullptr);
+
+		vkDestroyPipelineLayout(m_Device, m_ParticlePipelineLayout, nullptr);
 
 		vkDestroyRenderPass(m_Device, m_RenderPass, nullptr);
+		vkDestroyRenderPass(m_Device, m_LateRenderPass, nullptr);
 
 		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
 			vkDestroySemaphore(m_Device, imageAvailableSemaphores[i], nullptr);
 			vkDestroySemaphore(m_Device, renderFinishedSemaphores[i], nullptr);
 			vkDestroyFence(m_Device, inFlightFences[i], nullptr);
+			vkDestroySemaphore(m_Device, m_ComputeFinishedSemaphores[i], nullptr);
+			vkDestroyFence(m_Device, m_ComputeInFlightFences[i], nullptr);
 		}
 
 		// Command buffers will be automatically freed when their command pool is destroyed, so we don't need explicit cleanup.
 		vkDestroyCommandPool(m_Device, m_CommandPool, nullptr);
+		vkDestroyCommandPool(m_Device, m_ComputeCommandPool, nullptr);
+		m_Uploader.Shutdown();
+
+		// Everything compiled this run goes to the disk, the next start skips the compilation.
+		if (!m_PipelineCache.Save()) {
+			std::cerr << "[WARN] [PIPELINE] Failed to write the pipeline cache " << PIPELINE_CACHE_PATH << "." << std::endl;
+		}
+		m_PipelineCache.Shutdown();
 
+		m_Allocator.LogStatistics(std::cout);
+		m_Allocator.Shutdown();
 		vkDestroyDevice(m_Device, nullptr);
 
 		if constexpr (c_EnableValidationLayers) {
@@ -1454,9 +3494,11 @@ private:
 		vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
 		vkDestroyInstance(m_Instance, nullptr);
 
-		glfwDestroyWindow(m_Window);
+		if (!m_Parameters.headless) {
+			glfwDestroyWindow(m_Window);
 
-		glfwTerminate();
+			glfwTerminate();
+		}
 	}
 
 private:
@@ -1464,11 +3506,20 @@ private:
 
 		vkDestroyImageView(m_Device, m_ColorImageView, nullptr);
 		vkDestroyImage(m_Device, m_ColorImage, nullptr);
-		vkFreeMemory(m_Device, m_ColorImageMemory, nullptr);
+		m_Allocator.Free(m_ColorImageMemory);
 
 		vkDestroyImageView(m_Device, m_DepthImageView, nullptr);
 		vkDestroyImage(m_Device, m_DepthImage, nullptr);
-		vkFreeMemory(m_Device, m_DepthImageMemory, nullptr);
+		m_Allocator.Free(m_DepthImageMemory);
+
+		vkDestroyDescriptorPool(m_Device, m_DepthReduceDescriptorPool, nullptr);
+		for (VkImageView mipView: m_DepthPyramidMipViews) {
+			vkDestroyImageView(m_Device, mipView, nullptr);
+		}
+		m_DepthPyramidMipViews.clear();
+		vkDestroyImageView(m_Device, m_DepthPyramidImageView, nullptr);
+		vkDestroyImage(m_Device, m_DepthPyramidImage, nullptr);
+		m_Allocator.Free(m_DepthPyramidImageMemory);
 
 		for (auto framebuffer : m_SwapChainFramebuffers) {
 			vkDestroyFramebuffer(m_Device, framebuffer, nullptr);
@@ -1476,7 +3527,18 @@ private:
 		for (auto imageView : m_SwapChainImageViews) {
 			vkDestroyImageView(m_Device, imageView, nullptr);
 		}
-		vkDestroySwapchainKHR(m_Device, m_SwapChain, nullptr);
+
+		if (m_Parameters.headless) {
+			// We own the offscreen images, unlike the swapchain ones.
+			for (size_t i = 0; i < m_SwapChainImages.size(); ++i) {
+				vkDestroyImage(m_Device, m_SwapChainImages[i], nullptr);
+				m_Allocator.Free(m_OffscreenImagesMemory[i]);
+			}
+			m_SwapChainImages.clear();
+			m_OffscreenImagesMemory.clear();
+		} else {
+			vkDestroySwapchainKHR(m_Device, m_SwapChain, nullptr);
+		}
 	}
 
 	void recreateSwapChain() {
@@ -1498,6 +3560,8 @@ private:
 		createColorResources();
 		createDepthResources();
 		createFramebuffers();
+		// The culling reads the new depth pyramid.
+		writeCullingDepthPyramidDescriptors();
 	}
 
 	void drawFrame() {
@@ -1509,17 +3573,40 @@ private:
 		*  - Present the swap chain image
 		 */
 		// Synchronisation in Vulkan is **EXPLICIT** !!!
-		vkWaitForFences(m_Device, 1, &inFlightFences[m_CurrentFrame], VK_TRUE, UINT64_MAX);
+		// The compute fence protects the compute command buffer and uniform of this frame,
+		// the graphics one guarantees the particles drawn two frames ago aren't read anymore when the simulation overwrites them.
+		const VkFence frameFences[] = {inFlightFences[m_CurrentFrame], m_ComputeInFlightFences[m_CurrentFrame]};
+		vkWaitForFences(m_Device, 2, frameFences, VK_TRUE, UINT64_MAX);
+		readCullingStatistics(m_CurrentFrame);
+
+		// Headless: one offscreen target per frame in flight, the fence above already guarantees it's free.
+		uint32_t imageIndex = m_CurrentFrame;
+		if (!m_Parameters.headless) {
+			VkResult result = vkAcquireNextImageKHR(m_Device, m_SwapChain, UINT64_MAX, imageAvailableSemaphores[m_CurrentFrame], VK_NULL_HANDLE, &imageIndex); // Error might not mean program termination
+
+			if (result == VK_ERROR_OUT_OF_DATE_KHR /*|| result == VK_SUBOPTIMAL_KHR*/) {
+				recreateSwapChain();
+				return;
+			} else {
+				TRY_MSG(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR, "Failing to acquire the Swap Chain Image.");
+			}
+		}
 
-		uint32_t imageIndex;
-		VkResult result = vkAcquireNextImageKHR(m_Device, m_SwapChain, UINT64_MAX, imageAvailableSemaphores[m_CurrentFrame], VK_NULL_HANDLE, &imageIndex); // Error might not mean program termination
+		// Simulation first, it runs on the compute queue while the graphics queue finishes the previous frame.
+		updateComputeUniformBuffer();
+		vkResetFences(m_Device, 1, &m_ComputeInFlightFences[m_CurrentFrame]);
 
-		if (result == VK_ERROR_OUT_OF_DATE_KHR /*|| result == VK_SUBOPTIMAL_KHR*/) {
-			recreateSwapChain();
-			return;
-		} else {
-			TRY_MSG(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR, "Failing to acquire the Swap Chain Image.");
-		}
+		TRY_VK(vkResetCommandBuffer(m_ComputeCommandBuffers[m_CurrentFrame], 0));
+		recordComputeCommandBuffer(m_ComputeCommandBuffers[m_CurrentFrame]);
+
+		VkSubmitInfo computeSubmitInfo{};
+		computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		computeSubmitInfo.commandBufferCount = 1;
+		computeSubmitInfo.pCommandBuffers = &m_ComputeCommandBuffers[m_CurrentFrame];
+		computeSubmitInfo.signalSemaphoreCount = 1;
+		computeSubmitInfo.pSignalSemaphores = &m_ComputeFinishedSemaphores[m_CurrentFrame];
+
+		TRY_VK(vkQueueSubmit(m_ComputeQueue, 1, &computeSubmitInfo, m_ComputeInFlightFences[m_CurrentFrame]));
 
 		// Reset fence only if not recreating swap chain to avoid a deadlock in the next frame.
 		vkResetFences(m_Device, 1, &inFlightFences[m_CurrentFrame]); // Fence need manual reset.
@@ -1534,9 +3621,11 @@ private:
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-		VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[m_CurrentFrame]};
-		VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-		submitInfo.waitSemaphoreCount = 1;
+		// The particles are only read as vertices, everything before can overlap with the simulation.
+		// Without a swapchain there is no image to wait on nor anyone to signal.
+		VkSemaphore waitSemaphores[] = {m_ComputeFinishedSemaphores[m_CurrentFrame], imageAvailableSemaphores[m_CurrentFrame]};
+		VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+		submitInfo.waitSemaphoreCount = m_Parameters.headless ? 1 : 2;
 		submitInfo.pWaitSemaphores = waitSemaphores;
 		submitInfo.pWaitDstStageMask = waitStages;
 
@@ -1544,10 +3633,16 @@ private:
 		submitInfo.pCommandBuffers = &m_CommandBuffers[m_CurrentFrame];
 
 		VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[m_CurrentFrame]};
-		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.signalSemaphoreCount = m_Parameters.headless ? 0 : 1;
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
 		TRY_VK(vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, inFlightFences[m_CurrentFrame]));
+		++m_SubmittedFrameCount;
+
+		if (m_Parameters.headless) {
+			m_CurrentFrame = (m_CurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+			return;
+		}
 
 		VkSwapchainKHR swapChains[] = {m_SwapChain};
 
@@ -1563,7 +3658,7 @@ private:
 
 		presentInfo.pResults = nullptr; // Optional
 
-		result = vkQueuePresentKHR(m_PresentQueue, &presentInfo); // Error might not mean program termination
+		const VkResult result = vkQueuePresentKHR(m_PresentQueue, &presentInfo); // Error might not mean program termination
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_FramebufferResized) {
 			m_FramebufferResized = false;
@@ -1575,31 +3670,30 @@ private:
 		m_CurrentFrame = (m_CurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 	}
 
-	void dispatchCompute() {
-
+	void recordComputeCommandBuffer(VkCommandBuffer commandBuffer) {
 		VkCommandBufferBeginInfo beginInfo{};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-		if (vkBeginCommandBuffer(m_CommandBuffers[m_CurrentFrame], &beginInfo) != VK_SUCCESS) {
-			throw std::runtime_error("failed to begin recording command buffer!");
-		}
-
-		// ...
+		TRY_VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
 
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &computeDescriptorSets[i], 0, 0);
+		// This frame reads what the previous dispatch wrote, both being on the compute queue.
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
 
-		vkCmdDispatch(computeCommandBuffer, PARTICLE_COUNT / 256, 1, 1);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ComputePipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ComputePipelineLayout, 0, 1, &m_ComputeDescriptorSets[m_CurrentFrame], 0, nullptr);
 
-		// ...
+		vkCmdDispatch(commandBuffer, m_ParticleDispatchSize.width, m_ParticleDispatchSize.height, 1);
 
-		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-			throw std::runtime_error("failed to record command buffer!");
-		}
+		TRY_VK(vkEndCommandBuffer(commandBuffer));
 	}
 private:
 
-	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, const uint32_t mipLevels) {
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, const uint32_t mipLevels, const uint32_t baseMipLevel = 0) {
 		VkImageView imageView{VK_NULL_HANDLE};
 
 		VkImageViewCreateInfo viewInfo{};
@@ -1615,7 +3709,7 @@ private:
 		viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
 
 		viewInfo.subresourceRange.aspectMask = aspectFlags;
-		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
 		viewInfo.subresourceRange.levelCount = mipLevels;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
 		viewInfo.subresourceRange.layerCount = 1;
@@ -1625,7 +3719,7 @@ private:
 		return imageView;
 	}
 
-	void createImage(const uint32_t width, const uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSample, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+	void createImage(const uint32_t width, const uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSample, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, Imagine::Vulkan::MemoryAllocation& imageMemory) {
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -1657,52 +3751,13 @@ private:
 		TRY_VK(vkCreateImage(m_Device, &imageInfo, nullptr, &image));
 
 		// Allocating memory for the image the same way we allocate memory for a buffer.
-		VkMemoryRequirements memRequirements;
-		vkGetImageMemoryRequirements(m_Device, image, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-		TRY_VK(vkAllocateMemory(m_Device, &allocInfo, nullptr, &imageMemory));
-
-		vkBindImageMemory(m_Device, image, imageMemory, 0);
-	}
-
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-		auto cmdBuffer = beginSingleTimeCommands();
-		VkBufferImageCopy region{};
-		region.bufferOffset = 0;
-		region.bufferRowLength = 0;
-		region.bufferImageHeight = 0;
-
-		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = 0;
-		region.imageSubresource.layerCount = 1;
-
-		region.imageOffset = {0, 0, 0};
-		region.imageExtent = {
-			width,
-			height,
-			1
-		};
-
-		vkCmdCopyBufferToImage(
-			cmdBuffer,
-			buffer,
-			image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&region
-		);
-
-		endSingleTimeCommands(cmdBuffer);
+		// The tiling matters, optimal images can't share a `bufferImageGranularity` page with buffers.
+		imageMemory = m_Allocator.AllocateForImage(image, tiling, properties);
 	}
 
+	// Records the transition in the current upload batch.
 	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldImageLayout, VkImageLayout newImageLayout, const uint32_t mipLevels) {
-		auto commandBuffer = beginSingleTimeCommands();
+		const VkCommandBuffer commandBuffer = m_Uploader.GetCommandBuffer();
 		VkImageMemoryBarrier barrier{};
 		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		barrier.oldLayout = oldImageLayout; // we can use VK_IMAGE_LAYOUT_UNDEFINED if we don't care about the existing contents of the image.
@@ -1777,93 +3832,33 @@ private:
 			0, nullptr,
 			1, &barrier
 		);
-
-		endSingleTimeCommands(commandBuffer);
-	}
-
-	VkCommandBuffer beginSingleTimeCommands() {
-
-		// As it's a command, we need a temporary command buffer to allow the transfer.
-		//  Might be doable in a pre-draw dedicated command buffer and a list of those temporary buffer.
-		VkCommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = m_CommandPool;
-		allocInfo.commandBufferCount = 1;
-
-		VkCommandBuffer commandBuffer;
-		vkAllocateCommandBuffers(m_Device, &allocInfo, &commandBuffer);
-
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; // We'll only use the command buffer once for the copy. We tell it to the driver so mayber some opti will be done ?
-
-		vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-		return commandBuffer;
-	}
-
-	void endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-		vkEndCommandBuffer(commandBuffer);
-
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-
-		vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(m_GraphicsQueue);
-
-		vkFreeCommandBuffers(m_Device, m_CommandPool, 1, &commandBuffer);
 	}
 
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+	// `queueFamilies` lists the families accessing the buffer without ownership transfer, leave it empty for an exclusive buffer.
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, Imagine::Vulkan::MemoryAllocation& bufferMemory, const std::vector<uint32_t>& queueFamilies = {}) {
 		// Creating the buffer
 		VkBufferCreateInfo bufferInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		bufferInfo.size = size;
 		bufferInfo.usage = usage;
-		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // To edit if we want to go through a different queue family specifically for transfer operations
-		bufferInfo.flags = 0;
-		TRY_VK(vkCreateBuffer(m_Device, &bufferInfo, nullptr, &buffer))
-
-		// Allocating the memory required by the buffer
-		VkMemoryRequirements memRequirements;
-		vkGetBufferMemoryRequirements(m_Device, buffer, &memRequirements);
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-		TRY_VK(vkAllocateMemory(m_Device, &allocInfo, nullptr, &bufferMemory));
-
-		// Binding said memory to the vertex buffer object.
-		vkBindBufferMemory(m_Device, buffer, bufferMemory, 0);
-	}
-
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-		VkBufferCopy copyRegion{};
-		copyRegion.srcOffset = 0; // Optional
-		copyRegion.dstOffset = 0; // Optional
-		copyRegion.size = size;
-		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-		endSingleTimeCommands(commandBuffer);
-	}
-
-	uint32_t findMemoryType(const uint32_t typeFilter, const VkMemoryPropertyFlags properties) {
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &memProperties);
 
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-			if ((typeFilter & (1 << i))  && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-				return i;
-			}
+		// Exclusive even with a dedicated transfer queue, the upload batcher transfers the ownership to the graphics queue after the copy.
+		// Concurrent sharing requires unique family indices, and at least two of them.
+		const std::set<uint32_t> uniqueQueueFamilies(queueFamilies.begin(), queueFamilies.end());
+		const std::vector<uint32_t> sharedQueueFamilies(uniqueQueueFamilies.begin(), uniqueQueueFamilies.end());
+		if (sharedQueueFamilies.size() > 1) {
+			bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedQueueFamilies.size());
+			bufferInfo.pQueueFamilyIndices = sharedQueueFamilies.data();
+		} else {
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		}
+		bufferInfo.flags = 0;
+		TRY_VK(vkCreateBuffer(m_Device, &bufferInfo, nullptr, &buffer))
 
-		throw std::runtime_error("failed to find suitable memory type!");
+		// Allocating the memory required by the buffer and binding said memory to the buffer object.
+		// The allocator sub-allocates from big blocks, we don't get a VkDeviceMemory of our own (see maxMemoryAllocationCount).
+		bufferMemory = m_Allocator.AllocateForBuffer(buffer, properties);
 	}
 
 	int rateDeviceSuitability(VkPhysicalDevice device) {
@@ -1890,7 +3885,17 @@ private:
 		score += getMaxUsableSampleCount(device) * 10.0f;
 
 		// Application can't function without geometry shaders
-		if (!deviceFeatures.geometryShader) {
+		// (Not when running headless, we don't actually use them and the CI/software devices must stay eligible.)
+		if (!deviceFeatures.geometryShader && !m_Parameters.headless) {
+			return 0;
+		}
+
+		// The whole scene is drawn indirectly.
+		if (!deviceFeatures.drawIndirectFirstInstance) {
+			return 0;
+		}
+
+		if (deviceProperties.apiVersion < VK_API_VERSION_1_2 || !checkDescriptorIndexingSupport(device)) {
 			return 0;
 		}
 
@@ -1900,10 +3905,15 @@ private:
 		}
 
 		QueueFamilyIndices indices = findQueueFamilies(device);
-		if (!indices.IsComplete()) {
+		if (!indices.IsComplete(!m_Parameters.headless)) {
 			return 0;
 		}
 
+		if (m_Parameters.headless) {
+			// Don't let the score drop to 0 for a device that is otherwise suitable.
+			return std::max(score, 1);
+		}
+
 		// SwapChain Extension must be checked BEFORE the support of the swap chain (if any is needed).
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 		const bool swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -1922,29 +3932,51 @@ private:
 
 		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
 		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
-		int i = 0;
+		std::optional<uint32_t> dedicatedComputeFamily;
+		uint32_t i = 0;
 		for (const auto& queueFamily : queueFamilies) {
 
-			//TODO: See for asynchronous compute family queue.
+			// A compute family without graphics lets the particle simulation run asynchronously, next to the rendering.
+			if (!dedicatedComputeFamily.has_value() && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+				dedicatedComputeFamily = i;
+			}
 
 			// Vulkan requires an implementation which supports graphics operations to have at least one queue family that supports both graphics and compute operations.
-			if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) ) {
+			if (!indices.graphicsFamily.has_value() && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) ) {
 				indices.graphicsFamily = i;
 				indices.computeFamily = i;
 			}
 
-			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface, &presentSupport);
-			if (presentSupport) {
-				indices.presentFamily = i;
+			// A family with transfer and nothing else is usually backed by the DMA engines, copies there don't take time from the graphics queue.
+			// Copies to images must be allowed at any texel granularity, we don't want to deal with the others.
+			const VkExtent3D& granularity = queueFamily.minImageTransferGranularity;
+			const bool transferOnly = (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+			if (!indices.transferFamily.has_value() && transferOnly && granularity.width == 1 && granularity.height == 1 && granularity.depth == 1) {
+				indices.transferFamily = i;
 			}
 
-			if (indices.IsComplete()) {
-				break;
+			// No surface when headless, therefore no present queue to look for.
+			if (!m_Parameters.headless && !indices.presentFamily.has_value()) {
+				VkBool32 presentSupport = false;
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface, &presentSupport);
+				if (presentSupport) {
+					indices.presentFamily = i;
+				}
 			}
+
 			++i;
 		}
 
+		// Graphics queues can always do transfers.
+		if (!indices.transferFamily.has_value()) {
+			indices.transferFamily = indices.graphicsFamily;
+		}
+
+		// Otherwise the compute work is submitted to the graphics queue.
+		if (dedicatedComputeFamily.has_value()) {
+			indices.computeFamily = dedicatedComputeFamily;
+		}
+
 
 		return indices;
 	}
@@ -2072,10 +4104,13 @@ private:
 	}
 
 	std::vector<const char *> getRequiredInstanceExtensions() {
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		std::vector<const char *> extensions;
 
-		std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		if (!m_Parameters.headless) {
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 
 		if (c_EnableValidationLayers) {
 			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -2090,7 +4125,7 @@ private:
 			TRY_MSG(checkValidationLayerSupport(), "validation layers requested, but not available!");
 		}
 
-		{
+		if (!m_Parameters.headless) {
 			uint32_t glfwExtensionCount = 0;
 			const char **glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 			TRY_MSG(checkExtensionsSupport(glfwExtensions, glfwExtensionCount), "GLFW Extensions are not available.");
@@ -2103,7 +4138,8 @@ private:
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = "No Engine";
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
+		// Descriptor indexing is core since 1.2, the bindless texture table needs it.
+		appInfo.apiVersion = VK_API_VERSION_1_2;
 
 		// ==================== VkInstanceCreateInfo ====================
 		VkInstanceCreateInfo createInfo{};
@@ -2130,6 +4166,28 @@ private:
 		TRY_VK_MSG(vkCreateInstance(&createInfo, nullptr, &m_Instance), "failed to create a Vulkan Instance!");
 	}
 
+	std::vector<const char*> getRequiredDeviceExtensions() const {
+		// The swapchain is the only device extension we need, and only to present to a window.
+		if (m_Parameters.headless) {
+			return {};
+		}
+		return c_DeviceExtensions;
+	}
+
+	// What the bindless texture table relies on.
+	static bool checkDescriptorIndexingSupport(const VkPhysicalDevice device) {
+		VkPhysicalDeviceVulkan12Features features12{};
+		features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		VkPhysicalDeviceFeatures2 features{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &features12;
+		vkGetPhysicalDeviceFeatures2(device, &features);
+
+		return features12.descriptorIndexing && features12.runtimeDescriptorArray && features12.descriptorBindingPartiallyBound
+			   && features12.descriptorBindingSampledImageUpdateAfterBind && features12.descriptorBindingUpdateUnusedWhilePending
+			   && features12.shaderSampledImageArrayNonUniformIndexing;
+	}
+
 	bool checkDeviceExtensionSupport(const VkPhysicalDevice device) {
 		uint32_t extensionCount;
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -2137,7 +4195,8 @@ private:
 		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-		std::set<std::string> requiredExtensions(c_DeviceExtensions.begin(), c_DeviceExtensions.end());
+		const std::vector<const char*> deviceExtensions = getRequiredDeviceExtensions();
+		std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
 		for (const auto& extension : availableExtensions) {
 			requiredExtensions.erase(extension.extensionName);
@@ -2165,7 +4224,8 @@ private: // Debuging
 		return findSupportedFormat(
 			{VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
 			VK_IMAGE_TILING_OPTIMAL,
-			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+			// Sampled by the depth pyramid.
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
 		);
 	}
 
@@ -2176,7 +4236,8 @@ private: // Debuging
 	VkSampleCountFlagBits getMaxUsableSampleCount(VkPhysicalDevice physical_device) {
 		VkPhysicalDeviceProperties physicalDeviceProperties;
 		vkGetPhysicalDeviceProperties(physical_device, &physicalDeviceProperties);
-		const VkSampleCountFlags counts = physicalDeviceProperties.limits.framebufferColorSampleCounts & physicalDeviceProperties.limits.framebufferDepthSampleCounts;
+		// The depth attachment is sampled as well.
+		const VkSampleCountFlags counts = physicalDeviceProperties.limits.framebufferColorSampleCounts & physicalDeviceProperties.limits.framebufferDepthSampleCounts & physicalDeviceProperties.limits.sampledImageDepthSampleCounts;
 
 		if (counts & VK_SAMPLE_COUNT_64_BIT) { return VK_SAMPLE_COUNT_64_BIT; }
 		if (counts & VK_SAMPLE_COUNT_32_BIT) { return VK_SAMPLE_COUNT_32_BIT; }
@@ -2239,15 +4300,27 @@ private:
 
 		TRY_VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
 
+		// Two-phase occlusion culling: the early phase draws what was visible last frame, which is a good guess of the occluders.
+		// Its depth gives the depth pyramid, against which the late phase tests everything and draws what became visible.
+		recordCullingCommands(commandBuffer, CullingPhase::Early);
+		recordScenePass(commandBuffer, imageIndex, CullingPhase::Early);
+		recordDepthPyramid(commandBuffer);
+		recordCullingCommands(commandBuffer, CullingPhase::Late);
+		recordScenePass(commandBuffer, imageIndex, CullingPhase::Late);
+
+		TRY_VK(vkEndCommandBuffer(commandBuffer));
+	}
+
+	void recordScenePass(VkCommandBuffer commandBuffer, uint32_t imageIndex, const CullingPhase phase) {
 		VkRenderPassBeginInfo renderPassInfo{};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = m_RenderPass;
+		renderPassInfo.renderPass = phase == CullingPhase::Early ? m_RenderPass : m_LateRenderPass;
 		renderPassInfo.framebuffer = m_SwapChainFramebuffers.at(imageIndex);
 
 		renderPassInfo.renderArea.offset = {0, 0};
 		renderPassInfo.renderArea.extent = m_SwapChainExtent;
 
-		// Same order as attachment order.
+		// Same order as attachment order. Ignored by the late pass, which loads the attachments.
 		std::array<VkClearValue, 2> clearValues{};
 		clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
 		clearValues[1].depthStencil = {1.0f, 0};
@@ -2278,17 +4351,200 @@ private:
 		VkBuffer vertexBuffers[] = {m_VertexBuffer};
 		VkDeviceSize offsets[] = {0};
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer, 0, VK_INDEX_TYPE_UINT32); // TODO: Set the type depending on what the type of the index buffer is.
 
-		// Binding Uniforms
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &m_DescriptorSets[m_CurrentFrame], 0, nullptr);
+		// Binding Uniforms, and the textures of every material at once.
+		const std::array<VkDescriptorSet, 2> descriptorSets = {m_DescriptorSets[m_CurrentFrame], m_TextureTable.GetDescriptorSet()};
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
+
+		DrawPushConstants pushConstants{};
+		pushConstants.model = m_SceneTransform;
+		vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
 
 		// Drawing the vertices.
 		// vkCmdDraw(commandBuffer, static_cast<uint32_t>(c_Vertices.size()), 1, 0, 0);
-		vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(m_Indices.size()), 1, 0, 0, 0);
+		// The whole scene comes from the culled command buffer, one indirect call per index type whatever the number of objects,
+		// and one instanced command per index range whatever the number of copies. The culling pass set the instance counts,
+		// the commands without any visible instance are skipped by the GPU.
+		// The index type is only set by vkCmdBindIndexBuffer, hence the batches.
+		const VkBuffer culledCommandBuffer = m_CulledCommandBuffers[m_CurrentFrame];
+		for (const IndirectBatch& batch: m_IndirectBatches) {
+			vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer, 0, batch.indexType);
+			const VkDeviceSize batchOffset = sizeof(VkDrawIndexedIndirectCommand) * batch.firstCommand;
+			// Only split when the batch exceeds maxDrawIndirectCount, which is 1 without multiDrawIndirect.
+			for (uint32_t command = 0; command < batch.commandCount; command += m_MaxDrawIndirectCount) {
+				const uint32_t commandCount = std::min(m_MaxDrawIndirectCount, batch.commandCount - command);
+				vkCmdDrawIndexedIndirect(commandBuffer, culledCommandBuffer, batchOffset + sizeof(VkDrawIndexedIndirectCommand) * command, commandCount, sizeof(VkDrawIndexedIndirectCommand));
+			}
+		}
+
+		// The particles simulated for this frame, drawn straight from the storage buffer.
+		// They don't occlude anything, they're only drawn once the scene is complete.
+		if (phase == CullingPhase::Late) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_ParticlePipeline);
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_ShaderStorageBuffers[m_CurrentFrame], offsets);
+			vkCmdDraw(commandBuffer, m_Parameters.particleCount, 1, 0, 0);
+		}
 
 		vkCmdEndRenderPass(commandBuffer);
-		TRY_VK(vkEndCommandBuffer(commandBuffer));
+	}
+
+	void recordCullingCommands(VkCommandBuffer commandBuffer, const CullingPhase phase) {
+		if (m_DrawCount == 0) {
+			return;
+		}
+
+		const VkBuffer culledCommandBuffer = m_CulledCommandBuffers[m_CurrentFrame];
+		const VkBuffer drawCountBuffer = m_DrawCountBuffers[m_CurrentFrame];
+
+		// The early draws must be done with the commands before they're reset for the late phase,
+		// the visibility written by the late phase of the previous frame must be visible to this one,
+		// and the readback copy of the early draw count must be done before the late phase clears it.
+		VkMemoryBarrier reuseBarrier{};
+		reuseBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		reuseBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		reuseBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &reuseBarrier, 0, nullptr, 0, nullptr);
+
+		// Nothing was visible before the first frame, the late phase draws everything that passes.
+		if (!m_VisibilityBufferCleared) {
+			vkCmdFillBuffer(commandBuffer, m_VisibilityBuffer, 0, VK_WHOLE_SIZE, 0);
+			m_VisibilityBufferCleared = true;
+		}
+		// The previous use of the buffers by this frame is already complete, the fence of the frame guarantees it.
+		vkCmdFillBuffer(commandBuffer, drawCountBuffer, 0, VK_WHOLE_SIZE, 0);
+		// Every command starts without any instance.
+		VkBufferCopy commandCopy{};
+		commandCopy.srcOffset = 0;
+		commandCopy.dstOffset = 0;
+		commandCopy.size = sizeof(VkDrawIndexedIndirectCommand) * m_CommandCount;
+		vkCmdCopyBuffer(commandBuffer, m_DrawCommandBuffer, culledCommandBuffer, 1, &commandCopy);
+
+		VkMemoryBarrier clearBarrier{};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+		const uint32_t phaseIndex = static_cast<uint32_t>(phase);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullingPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullingPipelineLayout, 0, 1, &m_CullingDescriptorSets[m_CurrentFrame], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, m_CullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(phaseIndex), &phaseIndex);
+		vkCmdDispatch(commandBuffer, (m_DrawCount + m_CullingWorkgroupSize - 1) / m_CullingWorkgroupSize, 1, 1);
+
+		// The instance counts feed the indirect draws, the visible draws the vertex shader, and the count is read back for the statistics.
+		VkMemoryBarrier cullingBarrier{};
+		cullingBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		cullingBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullingBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &cullingBarrier, 0, nullptr, 0, nullptr);
+
+		// Each phase has its own slot in the readback buffer.
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = 0;
+		copyRegion.dstOffset = sizeof(uint32_t) * phaseIndex;
+		copyRegion.size = sizeof(uint32_t);
+		vkCmdCopyBuffer(commandBuffer, drawCountBuffer, m_DrawCountReadbackBuffers[m_CurrentFrame], 1, &copyRegion);
+
+		if (phase == CullingPhase::Late) {
+			VkMemoryBarrier readbackBarrier{};
+			readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &readbackBarrier, 0, nullptr, 0, nullptr);
+
+			m_CullingStatisticsPending[m_CurrentFrame] = true;
+		}
+	}
+
+	// Farthest depth of the early pass in a mip chain, each level reduced from the previous one.
+	void recordDepthPyramid(VkCommandBuffer commandBuffer) {
+		// The content of the last frame is discarded, the late culling of the last frame is done with it.
+		VkImageMemoryBarrier pyramidBarrier{};
+		pyramidBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		pyramidBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		pyramidBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		pyramidBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		pyramidBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		pyramidBarrier.image = m_DepthPyramidImage;
+		pyramidBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		pyramidBarrier.subresourceRange.baseMipLevel = 0;
+		pyramidBarrier.subresourceRange.levelCount = m_DepthPyramidMipLevels;
+		pyramidBarrier.subresourceRange.baseArrayLayer = 0;
+		pyramidBarrier.subresourceRange.layerCount = 1;
+		pyramidBarrier.srcAccessMask = 0;
+		pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &pyramidBarrier);
+
+		VkExtent2D inputExtent = m_SwapChainExtent;
+		VkExtent2D outputExtent = m_DepthPyramidExtent;
+		for (uint32_t level = 0; level < m_DepthPyramidMipLevels; ++level) {
+			const bool multisampled = level == 0 && m_MsaaSamples != VK_SAMPLE_COUNT_1_BIT;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, multisampled ? m_DepthReduceMultisampledPipeline : m_DepthReducePipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_DepthReducePipelineLayout, 0, 1, &m_DepthReduceDescriptorSets[level], 0, nullptr);
+
+			DepthReducePushConstants pushConstants{};
+			pushConstants.inputSize = glm::ivec2(static_cast<int32_t>(inputExtent.width), static_cast<int32_t>(inputExtent.height));
+			pushConstants.outputSize = glm::ivec2(static_cast<int32_t>(outputExtent.width), static_cast<int32_t>(outputExtent.height));
+			pushConstants.sampleCount = static_cast<int32_t>(m_MsaaSamples);
+			vkCmdPushConstants(commandBuffer, m_DepthReducePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, (outputExtent.width + DEPTH_REDUCE_WORKGROUP_SIZE - 1) / DEPTH_REDUCE_WORKGROUP_SIZE, (outputExtent.height + DEPTH_REDUCE_WORKGROUP_SIZE - 1) / DEPTH_REDUCE_WORKGROUP_SIZE, 1);
+
+			// The next level, or the late culling, reads this one.
+			VkMemoryBarrier levelBarrier{};
+			levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+
+			inputExtent = outputExtent;
+			outputExtent.width = std::max(1u, outputExtent.width / 2);
+			outputExtent.height = std::max(1u, outputExtent.height / 2);
+		}
+	}
+
+	// Read the draw counts of the last use of the frame, the caller waited on its fence.
+	void readCullingStatistics(const uint16_t frame) {
+		if (!m_CullingStatisticsPending[frame]) {
+			return;
+		}
+		m_CullingStatisticsPending[frame] = false;
+
+		// The early count, then the late one.
+		const auto* drawCounts = static_cast<const uint32_t*>(m_DrawCountReadbackBuffersMemory[frame].mapped);
+		const uint32_t visibleDrawCount = drawCounts[0] + drawCounts[1];
+		const uint32_t lateDrawCount = drawCounts[1];
+
+		++m_CullingStatistics.frameCount;
+		m_CullingStatistics.visibleDrawCount += visibleDrawCount;
+		m_CullingStatistics.totalDrawCount += m_DrawCount;
+		m_CullingStatistics.lastVisibleDrawCount = visibleDrawCount;
+		m_CullingStatistics.lastLateDrawCount = lateDrawCount;
+	}
+
+	void updateCullingUniformBuffer(const UniformBufferObject& ubo) {
+		CullingUniformBuffer culling{};
+
+		// Gribb & Hartmann: the planes are combinations of the rows of the matrix, with a depth between 0 and 1.
+		const glm::mat4 matrix = ubo.proj * ubo.view * m_SceneTransform;
+		culling.viewProjection = matrix;
+		const glm::vec4 row0{matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]};
+		const glm::vec4 row1{matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]};
+		const glm::vec4 row2{matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]};
+		const glm::vec4 row3{matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]};
+		culling.planes[0] = row3 + row0;
+		culling.planes[1] = row3 - row0;
+		culling.planes[2] = row3 + row1;
+		culling.planes[3] = row3 - row1;
+		culling.planes[4] = row2;
+		culling.planes[5] = row3 - row2;
+		for (glm::vec4& plane: culling.planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+
+		culling.depthPyramidSize = glm::vec2(static_cast<float>(m_DepthPyramidExtent.width), static_cast<float>(m_DepthPyramidExtent.height));
+		culling.drawCount = m_DrawCount;
+
+		memcpy(m_CullingUniformBuffersMemory[m_CurrentFrame].mapped, &culling, sizeof(culling));
 	}
 
 	void updateUniformBuffer(uint32_t imageIndex) {
@@ -2297,21 +4553,65 @@ private:
 		auto currentTime = std::chrono::high_resolution_clock::now();
 		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
+		// Pushed with the draws.
+		m_SceneTransform = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
 		UniformBufferObject ubo{};
-		ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 		ubo.proj = glm::perspective(glm::radians(45.0f), m_SwapChainExtent.width / (float) m_SwapChainExtent.height, 0.1f, 10.0f);
 		ubo.proj[1][1] *= -1;
 		memcpy(m_UniformBuffersMapped[m_CurrentFrame], &ubo, sizeof(ubo));
+
+		updateCullingUniformBuffer(ubo);
+	}
+
+	void updateComputeUniformBuffer() {
+		const auto currentTime = std::chrono::steady_clock::now();
+
+		ComputeUniformBuffer ubo{};
+		// In milliseconds, the first frame doesn't move.
+		ubo.deltaTime = m_LastFrameTime.has_value() ? std::chrono::duration<float, std::milli>(currentTime - *m_LastFrameTime).count() : 0.0f;
+		ubo.particleCount = m_Parameters.particleCount;
+		m_LastFrameTime = currentTime;
+
+		memcpy(m_ComputeUniformBuffersMapped[m_CurrentFrame], &ubo, sizeof(ubo));
 	}
 private:
+	ApplicationParameters m_Parameters{};
 	GLFWwindow* m_Window{nullptr};
 	VkInstance m_Instance{VK_NULL_HANDLE};
 	VkPhysicalDevice m_PhysicalDevice{VK_NULL_HANDLE};
 	VkDevice m_Device{VK_NULL_HANDLE};
+	Imagine::Vulkan::DeviceMemoryAllocator m_Allocator{};
+	// Records every asset upload, declared after the allocator as it owns allocations.
+	Imagine::Vulkan::UploadBatcher m_Uploader{};
+	Imagine::Vulkan::PipelineCache m_PipelineCache{};
+	Imagine::Vulkan::PipelineVariantCache m_PipelineVariants{};
+	// The specialization constants of the current compute pipeline variants.
+	uint32_t m_ParticleWorkgroupSize{PARTICLE_WORKGROUP_SIZE};
+	uint32_t m_CullingWorkgroupSize{CULLING_WORKGROUP_SIZE};
+	// CPU side work of the initialization.
+	Imagine::Core::ThreadPool m_ThreadPool{};
+	// The pipelines being compiled on the thread pool, see startPipelineCompilation.
+	std::vector<std::future<void>> m_PipelineJobs{};
+	std::chrono::steady_clock::time_point m_PipelineCompilationStart{};
+
+	struct RetiredPipeline {
+		VkPipeline pipeline;
+		// m_SubmittedFrameCount when it got replaced.
+		uint64_t submittedFrameCount;
+	};
+	Imagine::Core::FileWatcher m_ShaderWatcher{};
+	// Shader files changed while another one was reloading.
+	std::set<std::string> m_PendingShaderFiles{};
+	std::future<std::vector<RebuiltPipeline>> m_ShaderReload{};
+	std::array<std::vector<uint32_t>, static_cast<size_t>(ShaderId::Count)> m_ReloadedShaders{};
+	std::vector<RetiredPipeline> m_RetiredPipelines{};
+	uint64_t m_SubmittedFrameCount{0};
 	VkQueue m_ComputeQueue{VK_NULL_HANDLE};
 	VkQueue m_GraphicsQueue{VK_NULL_HANDLE};
 	VkQueue m_PresentQueue{VK_NULL_HANDLE};
+	VkQueue m_TransferQueue{VK_NULL_HANDLE};
 	VkSurfaceKHR m_Surface{VK_NULL_HANDLE};
 	VkSwapchainKHR m_SwapChain{VK_NULL_HANDLE};
 	VkDebugUtilsMessengerEXT debugMessenger{VK_NULL_HANDLE};
@@ -2321,21 +4621,35 @@ private:
 	std::vector<VkImage> m_SwapChainImages;
 	std::vector<VkImageView> m_SwapChainImageViews;
 	std::vector<VkFramebuffer> m_SwapChainFramebuffers;
+	// Only used when headless, backing memory of the offscreen images stored in m_SwapChainImages.
+	std::vector<Imagine::Vulkan::MemoryAllocation> m_OffscreenImagesMemory;
 
 	VkPipeline m_ComputePipeline{VK_NULL_HANDLE};
 	VkPipelineLayout m_ComputePipelineLayout{VK_NULL_HANDLE};
 	std::vector<VkBuffer> m_ShaderStorageBuffers{};
-	std::vector<VkDeviceMemory> m_ShaderStorageBuffersMemory{};
+	std::vector<Imagine::Vulkan::MemoryAllocation> m_ShaderStorageBuffersMemory{};
 	VkDescriptorSetLayout m_ComputeDescriptorSetLayout{VK_NULL_HANDLE};
 	std::vector<VkDescriptorSet> m_ComputeDescriptorSets{};
 	VkDescriptorPool m_ComputeDescriptorPool{VK_NULL_HANDLE};
+	// Allocates on the compute family, which may differ from the graphics one.
+	VkCommandPool m_ComputeCommandPool{VK_NULL_HANDLE};
+	std::vector<VkCommandBuffer> m_ComputeCommandBuffers{};
+	std::vector<VkSemaphore> m_ComputeFinishedSemaphores{};
+	std::vector<VkFence> m_ComputeInFlightFences{};
+	std::optional<std::chrono::steady_clock::time_point> m_LastFrameTime{};
+	// Workgroups dispatched on X and Y to cover every particle.
+	VkExtent2D m_ParticleDispatchSize{1, 1};
+
+	VkPipeline m_ParticlePipeline{VK_NULL_HANDLE};
+	VkPipelineLayout m_ParticlePipelineLayout{VK_NULL_HANDLE};
 
 	// MSAA Image to sample.
 	VkImage m_ColorImage{VK_NULL_HANDLE};
-	VkDeviceMemory m_ColorImageMemory{VK_NULL_HANDLE};
+	Imagine::Vulkan::MemoryAllocation m_ColorImageMemory{};
 	VkImageView m_ColorImageView{VK_NULL_HANDLE};
 
 	VkRenderPass m_RenderPass{VK_NULL_HANDLE};
+	VkRenderPass m_LateRenderPass{VK_NULL_HANDLE};
 	VkDescriptorSetLayout m_DescriptorSetLayout{VK_NULL_HANDLE};
 	VkDescriptorPool m_DescriptorPool{VK_NULL_HANDLE};
 	std::vector<VkDescriptorSet> m_DescriptorSets{};
@@ -2343,22 +4657,91 @@ private:
 	VkPipeline m_GraphicsPipeline{VK_NULL_HANDLE};
 	VkCommandPool m_CommandPool{VK_NULL_HANDLE};
 
+	// Only filled by an import, released once uploaded.
 	std::vector<Vertex> m_Vertices;
 	std::vector<uint32_t> m_Indices;
+	Imagine::Core::MeshCache m_MeshCache{};
+	uint32_t m_VertexCount{0};
+	uint32_t m_IndexCount{0};
+	// Rotation of the whole scene, updated every frame.
+	glm::mat4 m_SceneTransform{1.0f};
 
 	VkBuffer m_VertexBuffer{VK_NULL_HANDLE};
-	VkDeviceMemory m_VertexBufferMemory{VK_NULL_HANDLE};
+	Imagine::Vulkan::MemoryAllocation m_VertexBufferMemory{};
 
 	VkBuffer m_IndexBuffer{VK_NULL_HANDLE};
-	VkDeviceMemory m_IndexBufferMemory{VK_NULL_HANDLE};
+	Imagine::Vulkan::MemoryAllocation m_IndexBufferMemory{};
+	std::vector<IndexedDraw> m_Draws{};
+
+	// Scene tables: each mesh is stored once, the instances place them.
+	std::vector<Imagine::Core::SceneMesh> m_Meshes{};
+	std::vector<Imagine::Core::SceneInstance> m_Instances{};
+	std::vector<MeshDrawRange> m_MeshDrawRanges{};
+	VkBuffer m_InstanceBuffer{VK_NULL_HANDLE};
+	Imagine::Vulkan::MemoryAllocation m_InstanceBufferMemory{};
+
+	// GPU driven drawing: one VkDrawIndexedIndirectCommand and one DrawData per draw.
+	VkBuffer m_DrawCommandBuffer{VK_NULL_HANDLE};
+	Imagine::Vulkan::MemoryAllocation m_DrawCommandBufferMemory{};
+	VkBuffer m_DrawDataBuffer{VK_NULL_HANDLE};
+	Imagine::Vulkan::MemoryAllocation m_DrawDataBufferMemory{};
+	std::vector<IndirectBatch> m_IndirectBatches{};
+	uint32_t m_CommandCount{0};
+	uint32_t m_DrawCount{0};
+	bool m_MultiDrawIndirect{false};
+	uint32_t m_MaxDrawIndirectCount{1};
+	VkBuffer m_MeshBuffer{VK_NULL_HANDLE};
+	Imagine::Vulkan::MemoryAllocation m_MeshBufferMemory{};
+	VkBuffer m_MaterialBuffer{VK_NULL_HANDLE};
+	Imagine::Vulkan::MemoryAllocation m_MaterialBufferMemory{};
+
+	// Frustum culling: the visible commands of m_DrawCommandBuffer are compacted per frame in m_CulledCommandBuffers.
+	VkPipeline m_CullingPipeline{VK_NULL_HANDLE};
+	VkPipelineLayout m_CullingPipelineLayout{VK_NULL_HANDLE};
+	VkDescriptorSetLayout m_CullingDescriptorSetLayout{VK_NULL_HANDLE};
+	VkDescriptorPool m_CullingDescriptorPool{VK_NULL_HANDLE};
+	std::vector<VkDescriptorSet> m_CullingDescriptorSets{};
+	std::vector<VkBuffer> m_CullingUniformBuffers{};
+	std::vector<Imagine::Vulkan::MemoryAllocation> m_CullingUniformBuffersMemory{};
+	std::vector<VkBuffer> m_CulledCommandBuffers{};
+	std::vector<Imagine::Vulkan::MemoryAllocation> m_CulledCommandBuffersMemory{};
+	// Indices in m_DrawDataBuffer, in the instance slots of the commands.
+	std::vector<VkBuffer> m_VisibleDrawBuffers{};
+	std::vector<Imagine::Vulkan::MemoryAllocation> m_VisibleDrawBuffersMemory{};
+	// Number of visible draws.
+	std::vector<VkBuffer> m_DrawCountBuffers{};
+	std::vector<Imagine::Vulkan::MemoryAllocation> m_DrawCountBuffersMemory{};
+	std::vector<VkBuffer> m_DrawCountReadbackBuffers{};
+	std::vector<Imagine::Vulkan::MemoryAllocation> m_DrawCountReadbackBuffersMemory{};
+	std::vector<bool> m_CullingStatisticsPending{};
+	CullingStatistics m_CullingStatistics{};
+	VkBuffer m_VisibilityBuffer{VK_NULL_HANDLE};
+	Imagine::Vulkan::MemoryAllocation m_VisibilityBufferMemory{};
+	bool m_VisibilityBufferCleared{false};
+
+	// Hierarchical depth of the early pass, rebuilt every frame and recreated with the swap chain.
+	VkImage m_DepthPyramidImage{VK_NULL_HANDLE};
+	Imagine::Vulkan::MemoryAllocation m_DepthPyramidImageMemory{};
+	VkImageView m_DepthPyramidImageView{VK_NULL_HANDLE};
+	std::vector<VkImageView> m_DepthPyramidMipViews{};
+	VkExtent2D m_DepthPyramidExtent{1, 1};
+	uint32_t m_DepthPyramidMipLevels{1};
+	VkSampler m_DepthPyramidSampler{VK_NULL_HANDLE};
+	VkDescriptorSetLayout m_DepthReduceDescriptorSetLayout{VK_NULL_HANDLE};
+	VkDescriptorPool m_DepthReduceDescriptorPool{VK_NULL_HANDLE};
+	std::vector<VkDescriptorSet> m_DepthReduceDescriptorSets{};
+	VkPipelineLayout m_DepthReducePipelineLayout{VK_NULL_HANDLE};
+	VkPipeline m_DepthReducePipeline{VK_NULL_HANDLE};
+	// Reads the multisampled depth attachment, only with MSAA.
+	VkPipeline m_DepthReduceMultisampledPipeline{VK_NULL_HANDLE};
 
 	// No staging buffer for the uniform. We're likely to edit those data every frame anyway.
 	std::vector<VkBuffer> m_UniformBuffers;
-	std::vector<VkDeviceMemory> m_UniformBuffersMemory;
+	std::vector<Imagine::Vulkan::MemoryAllocation> m_UniformBuffersMemory;
 	std::vector<void*> m_UniformBuffersMapped;
 
 	std::vector<VkBuffer> m_ComputeUniformBuffers;
-	std::vector<VkDeviceMemory> m_ComputeUniformBuffersMemory;
+	std::vector<Imagine::Vulkan::MemoryAllocation> m_ComputeUniformBuffersMemory;
 	std::vector<void*> m_ComputeUniformBuffersMapped;
 
 	// The following objects are vector with an indice for each frame they represents.
@@ -2371,12 +4754,14 @@ private:
 
 	uint32_t m_MipLevels{0};
 	VkImage m_TextureImage{VK_NULL_HANDLE};
-	VkDeviceMemory m_TextureImageMemory{VK_NULL_HANDLE};
+	Imagine::Vulkan::MemoryAllocation m_TextureImageMemory{};
 	VkImageView m_TextureImageView{VK_NULL_HANDLE};
 	VkSampler m_TextureSampler{VK_NULL_HANDLE};
+	Imagine::Vulkan::BindlessTextureTable m_TextureTable{};
+	uint32_t m_DefaultTextureIndex{0};
 
 	VkImage m_DepthImage{VK_NULL_HANDLE};
-	VkDeviceMemory m_DepthImageMemory{VK_NULL_HANDLE};
+	Imagine::Vulkan::MemoryAllocation m_DepthImageMemory{};
 	VkImageView m_DepthImageView{VK_NULL_HANDLE};
 
 	uint16_t m_CurrentFrame = 0;
@@ -2385,10 +4770,9 @@ private:
 	VkSampleCountFlagBits m_MsaaSamples = VK_SAMPLE_COUNT_1_BIT;
 };
 
-int main() {
-	HelloTriangleApplication app;
-
+int main(int argc, char** argv) {
 	try {
+		HelloTriangleApplication app(parseArguments(argc, argv));
 		app.run();
 	} catch (const std::exception &e) {
 		std::cerr << e.what() << std::endl;
@@ -1,3 +0,0 @@
-glslc.exe .\shader.vert -o shader.vert.spv
-glslc.exe .\shader.frag -o shader.frag.spv
-glslc.exe .\shader.comp -o shader.comp.spv
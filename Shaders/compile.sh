@@ -1,3 +0,0 @@
-glslc shader.vert -o shader.vert.spv
-glslc shader.frag -o shader.frag.spv
-glslc shader.comp -o shader.comp.spv
@@ -0,0 +1,13 @@
+#version 450
+
+layout(location = 0) in vec2 a_Position;
+layout(location = 1) in vec4 a_Color;
+
+layout(location = 0) out vec3 v_FragColor;
+
+void main() {
+    // The particles are simulated directly in normalized device coordinates.
+    gl_PointSize = 1.0;
+    gl_Position = vec4(a_Position.xy, 0.0, 1.0);
+    v_FragColor = a_Color.rgb;
+}
@@ -1,14 +1,19 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 v_FragColor;
 layout(location = 1) in vec2 v_TexCoord;
+layout(location = 2) flat in uint v_TextureIndex;
 
 layout(location = 0) out vec4 o_Color;
 
-layout(binding = 1) uniform sampler2D texSampler;
+// The bindless texture table, see BindlessTextureTable.
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler textureSampler;
 
 void main() {
     // o_Color = vec4(v_TexCoord, 0.0, 1.0);
-    o_Color = texture(texSampler, v_TexCoord);
+    // The index is the same for a whole draw, but not within a subgroup once the draws are merged.
+    o_Color = texture(sampler2D(textures[nonuniformEXT(v_TextureIndex)], textureSampler), v_TexCoord);
 
 }
\ No newline at end of file
@@ -1,21 +1,74 @@
 #version 450
 
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
     mat4 view;
     mat4 proj;
 } ubo;
 
+layout(push_constant) uniform DrawPushConstants {
+    mat4 model;
+} draw;
+
+struct MaterialData {
+    uint textureIndex;
+};
+
+layout(std430, binding = 1) readonly buffer MaterialBuffer {
+    MaterialData materials[];
+};
+
+struct InstanceData {
+    mat4 model;
+};
+
+layout(std430, binding = 2) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+};
+
+struct DrawData {
+    uint instanceIndex;
+    uint meshIndex;
+    uint materialIndex;
+    uint commandIndex;
+};
+
+layout(std430, binding = 3) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
+
+// Written by the culling pass: the visible draws of each instanced command, from its firstInstance.
+layout(std430, binding = 4) readonly buffer VisibleDrawBuffer {
+    uint visibleDraws[];
+};
+
+struct MeshData {
+    vec4 boundsMin;
+    vec4 boundsMax;
+    // Maps the quantized positions back to the bounds of the mesh, identity for float vertices.
+    vec4 positionScale;
+    vec4 positionOffset;
+};
+
+layout(std430, binding = 5) readonly buffer MeshBuffer {
+    MeshData meshes[];
+};
+
 layout(location = 0) in vec3 a_Position;
 layout(location = 1) in vec3 a_Color;
 layout(location = 2) in vec2 a_TexCoord;
 
 layout(location = 0) out vec3 v_FragColor;
 layout(location = 1) out vec2 v_TexCoord;
+// Index in the bindless texture table, the same for the whole draw.
+layout(location = 2) flat out uint v_TextureIndex;
 
 void main() {
 
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(a_Position, 1.0);
+    DrawData drawData = draws[visibleDraws[gl_InstanceIndex]];
+    MeshData mesh = meshes[drawData.meshIndex];
+    vec3 position = a_Position * mesh.positionScale.xyz + mesh.positionOffset.xyz;
+    gl_Position = ubo.proj * ubo.view * draw.model * instances[drawData.instanceIndex].model * vec4(position, 1.0);
     v_FragColor = a_Color;
     v_TexCoord = a_TexCoord;
+    v_TextureIndex = materials[drawData.materialIndex].textureIndex;
 }
\ No newline at end of file